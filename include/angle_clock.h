@@ -0,0 +1,83 @@
+#ifndef __ANGLE_CLOCK_H__
+#define __ANGLE_CLOCK_H__
+
+#include <atomic>
+#include <cstdint>
+
+#include "pico/stdlib.h"
+
+// Crank angle extrapolated from the last tooth, engine angles in 1/0x10000
+// of a 720° cycle. Written by the decoder on every tooth, read from any core
+// or ISR without locking: the snapshot is double buffered and the reader
+// retries if the decoder published a new one meanwhile. The decoder only
+// rewrites a slot after publishing the other one, a reader that interrupts
+// it mid-write still reads a whole snapshot.
+struct AngleClockSnapshot
+{
+    absolute_time_t base_ts; // tooth timestamp
+    uint32_t base_angle;     // engine angle of the tooth
+    uint32_t rate;           // engine angle per us, Q16
+    uint32_t cycle_us;       // 1 us per 720° cycle
+    uint32_t mask;           // 0xFFFF with cam phase, wheel angle - 1 otherwise
+};
+
+struct AngleClock
+{
+    AngleClockSnapshot slots[2] = {};
+    std::atomic<uint32_t> seq{0};
+
+    // writer side, a single producer
+    void set(absolute_time_t ts, uint angle, uint cycle_us, uint mask)
+    {
+        const uint32_t s = seq.load(std::memory_order_relaxed) + 1;
+        AngleClockSnapshot &c = slots[s & 1];
+        c.base_ts = ts;
+        c.base_angle = angle;
+        c.rate = cycle_us ? (1ULL << 32) / cycle_us : 0; // the only divide, once per tooth
+        c.cycle_us = cycle_us;
+        c.mask = mask;
+        seq.store(s, std::memory_order_release);
+    }
+    void stop()
+    {
+        set(0, 0, 0, 0);
+    }
+
+    bool get(AngleClockSnapshot &c) const
+    {
+        uint32_t s = seq.load(std::memory_order_acquire);
+        while (true)
+        {
+            c = slots[s & 1];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint32_t s2 = seq.load(std::memory_order_relaxed);
+            if (s2 == s)
+                break; // our slot cannot have been touched
+            s = s2;
+        }
+        return c.cycle_us != 0;
+    }
+
+    // engine angle at `now`, false if the engine is not synced
+    bool now_angle(absolute_time_t now, uint &angle) const
+    {
+        AngleClockSnapshot c;
+        if (!get(c))
+            return false;
+        // signed, `now` may be older than a tooth that just came in
+        angle = (c.base_angle + (int32_t)(((int64_t)(now - c.base_ts) * c.rate) >> 16)) & c.mask;
+        return true;
+    }
+
+    // next time the engine reaches `angle`, false if the engine is not synced
+    bool angle_to_time(uint angle, absolute_time_t &t) const
+    {
+        AngleClockSnapshot c;
+        if (!get(c))
+            return false;
+        t = c.base_ts + ((uint64_t)((angle - c.base_angle) & c.mask) * c.cycle_us >> 16);
+        return true;
+    }
+};
+
+#endif // __ANGLE_CLOCK_H__
@@ -0,0 +1,108 @@
+#ifndef __AXIS_H__
+#define __AXIS_H__
+
+#include <cstdint>
+
+#include "pico/stdlib.h"
+
+#include "linear_interp.h"
+
+// Table axis with the interpolation division done when the points load:
+// per bin, recip = ceil(2^shift / width) with shift = 8 + 2 * bits(width),
+// so 256 * (x - x0) * recip >> shift gives the same alpha as the division
+// for every x in the bin.
+template <size_t N, typename T = int16_t>
+struct Axis
+{
+    const T *points = nullptr;
+    uint32_t recip[N - 1];
+    uint8_t shift[N - 1];
+    size_t hint = 0; // bin of the last lookup
+
+    // Again every time the points change. Points must be increasing, a bin
+    // that is not gets alpha 0.
+    void load(const T *axis_points)
+    {
+        points = axis_points;
+        for (size_t i = 0; i < N - 1; i++)
+        {
+            const int width = points[i + 1] - points[i];
+            if (width <= 0)
+            {
+                recip[i] = 0;
+                shift[i] = 0;
+                continue;
+            }
+            shift[i] = 8 + 2 * (32 - __builtin_clz(width));
+            recip[i] = (uint32_t)(((1ULL << shift[i]) + width - 1) / width);
+        }
+        hint = 0;
+    }
+
+    // Bin of x clamped inside the axis, and its position in the bin, Q8
+    size_t find(T x, uint32_t *alpha)
+    {
+        x = MIN(MAX(x, points[0]), points[N - 1] - 1);
+        const size_t i = find_bin(points, N, x, &hint);
+        *alpha = (uint32_t)(((uint64_t)(256U * (x - points[i])) * recip[i]) >> shift[i]);
+        return i;
+    }
+};
+
+template <size_t N, typename T>
+static uint16_t linear_interp(Axis<N, T> &x_axis, const uint16_t *table, T x)
+{
+    uint32_t alpha;
+    const size_t ix = x_axis.find(x, &alpha);
+
+    InterpBlend interp;
+    interp.alpha(alpha);
+    return interp.blend(*(uint32_t *)(table + ix));
+}
+
+template <size_t NX, size_t NY, typename T>
+static uint16_t bilinear_interp(Axis<NX, T> &x_axis, Axis<NY, T> &y_axis, const uint16_t *table, T x, T y)
+{
+    uint32_t alpha_x, alpha_y;
+    const size_t ix = x_axis.find(x, &alpha_x);
+    const size_t iy = y_axis.find(y, &alpha_y);
+
+    InterpBlend interp;
+    interp.alpha(alpha_x);
+
+    const size_t offset = iy * NX + ix;
+    const uint16_t a = interp.blend(*(uint32_t *)(table + offset));      // blend on first row
+    const uint16_t b = interp.blend(*(uint32_t *)(table + offset + NX)); // blend on second row
+
+    interp.alpha(alpha_y);
+    return interp.blend(a | ((uint32_t)b << 16)); // blend of the final value
+}
+
+// NT tables on the same axes: bins and alphas are found once, then all the
+// rows are blended on x before all the results are blended on y
+template <size_t NT, size_t NX, size_t NY, typename T>
+static void bilinear_interp(
+    Axis<NX, T> &x_axis, Axis<NY, T> &y_axis,
+    const uint16_t *const (&tables)[NT], uint16_t (&out)[NT],
+    T x, T y)
+{
+    uint32_t alpha_x, alpha_y;
+    const size_t ix = x_axis.find(x, &alpha_x);
+    const size_t iy = y_axis.find(y, &alpha_y);
+    const size_t offset = iy * NX + ix;
+
+    uint16_t a[NT], b[NT];
+    InterpBlend interp;
+    interp.alpha(alpha_x);
+    for (size_t i = 0; i < NT; i++)
+    {
+        a[i] = interp.blend(*(uint32_t *)(tables[i] + offset));
+        b[i] = interp.blend(*(uint32_t *)(tables[i] + offset + NX));
+    }
+
+    interp.alpha(alpha_y);
+    for (size_t i = 0; i < NT; i++)
+        out[i] = interp.blend(a[i] | ((uint32_t)b[i] << 16));
+}
+
+#endif // __AXIS_H__
@@ -0,0 +1,120 @@
+#ifndef COIL_H
+#define COIL_H
+
+#include "pico/stdlib.h"
+
+#include "linear_interp.h"
+#include "output_stats.h"
+
+#define COIL_CURVE_SIZE 6
+
+// Ignition output: the dwell ends exactly at the spark. Both edges are
+// retimed from every tooth until they happen. Once the coil charges only the
+// spark moves, a late tooth shortens the dwell but never delays the spark.
+class Coil
+{
+    uint32_t pin_mask;
+    alarm_id_t alarm_id = 0; // dwell start, then spark
+    absolute_time_t alarm_at;
+    volatile bool pending = false;  // dwell start scheduled
+    volatile bool charging = false; // pin high
+    absolute_time_t dwell_start, spark_at;
+    uint dwell_max;
+    size_t dwell_bin = 0; // last bin of the dwell curve
+
+public:
+    OutputStats stats;
+
+    // Dwell against battery voltage, coil charge time grows as voltage drops
+    int16_t dwell_voltage[COIL_CURVE_SIZE] = {800, 1000, 1200, 1300, 1400, 1600}; // 0.01 V
+    uint16_t dwell_table[COIL_CURVE_SIZE] = {6000, 4500, 3500, 3000, 2700, 2300}; // 1 us
+    uint min_off = 1000; // 1 us, coil discharge before the next dwell
+
+    void init(uint pin)
+    {
+        pin_mask = (1 << pin);
+        gpio_init(pin);
+        gpio_set_dir(pin, GPIO_OUT);
+    }
+    uint dwell(int16_t battery_voltage)
+    {
+        return linear_interp(dwell_voltage, COIL_CURVE_SIZE, dwell_table, battery_voltage, &dwell_bin);
+    }
+    bool busy()
+    {
+        return pending || charging;
+    }
+
+    // From the decoder, on the tooth before the dwell and every tooth until
+    // the spark. spark_period: time between two sparks of this coil.
+    void update(absolute_time_t now, absolute_time_t spark, uint dwell, uint spark_period)
+    {
+        if (charging)
+        {
+            // a spark further than the dwell allows comes from a tooth past
+            // the spark angle, fire now rather than hold the coil a cycle
+            if (spark > dwell_start + dwell_max)
+                spark = now;
+            if ((spark != spark_at) && cancel_alarm(alarm_id))
+            {
+                spark_at = spark;
+                alarm_at = spark;
+                alarm_id = add_alarm_at(spark, Coil::callback, this, true);
+            }
+            return;
+        }
+
+        // leave the coil time to discharge at high rpm
+        dwell = MIN(dwell, (spark_period > min_off) ? spark_period - min_off : 0);
+        absolute_time_t start = spark - dwell;
+        if (start < now)
+            start = now; // late, shorter dwell and spark on time
+        if (pending && !cancel_alarm(alarm_id))
+            return; // dwell just started, next tooth retimes the spark
+        dwell_start = start;
+        spark_at = spark;
+        dwell_max = dwell + dwell / 2;
+        pending = true;
+        alarm_at = start;
+        alarm_id = add_alarm_at(start, Coil::callback, this, true);
+    }
+    // Interrupts must be disabled, the alarm callback must not run meanwhile
+    void cancel()
+    {
+        if (busy())
+            cancel_alarm(alarm_id);
+        gpio_clr_mask(pin_mask);
+        pending = false;
+        charging = false;
+        alarm_id = 0;
+    }
+
+private:
+    static int64_t __not_in_flash_func(callback)(alarm_id_t, void *data)
+    {
+        Coil *c = (Coil *)data;
+        const absolute_time_t now = time_us_64();
+        c->stats.add(MAX((int64_t)(now - c->alarm_at), 0));
+        if (c->charging)
+        {
+            gpio_clr_mask(c->pin_mask); // spark
+            c->charging = false;
+            return 0;
+        }
+        if (now >= c->spark_at)
+        {
+            c->pending = false;
+            c->stats.missed += 1; // no time left to charge
+            return 0;
+        }
+        // charging before pending is cleared, a tooth IRQ preempting the
+        // callback must never see the coil idle and start a second dwell
+        c->charging = true;
+        c->pending = false;
+        gpio_set_mask(c->pin_mask);
+        c->alarm_at = c->spark_at;
+        return -MAX((int64_t)(c->spark_at - c->dwell_start), 1);
+    }
+};
+
+#endif // COIL_H
@@ -4,13 +4,72 @@
 
 #include <stdio.h>
 #include "pico/stdlib.h"
-#include "pico/util/queue.h"
-#include "pico/sem.h"
-
-#include "libdivide.h"
 
+#include "angle_clock.h"
+#include "coil.h"
+#include "spsc_ring.h"
+#include "tooth_log.h"
 #include "trigger.h"
 #include "global_state.h"
+#include "wheel_pattern.h"
+
+// Number of tooth timestamps buffered between the GPIO IRQ and update().
+// Must cover the longest main loop stall at the highest tooth rate.
+#ifndef DECODER_RING_SIZE
+#define DECODER_RING_SIZE 64
+#endif
+
+// Predict event times from the cycle time trend, 0 assumes a constant speed
+// from the last tooth
+#ifndef DECODER_TREND_PREDICTION
+#define DECODER_TREND_PREDICTION 1
+#endif
+
+// Crank noise filter, one threshold per rpm band
+#define DECODER_FILTER_BANDS 3
+
+struct FilterBand
+{
+    uint rpm;      // upper rpm of the band, last band is open
+    uint fraction; // min edge spacing, 1/256 of the expected gap
+};
+
+// Below this speed the compression strokes slow the crank down within a
+// gap, the stall timeout waits twice the expected gap instead of +25%
+#define DECODER_CRANKING_RPM 400
+
+// No tooth for this long after a stall: the engine stopped, 1 us
+#define DECODER_STOP_US 1'000'000
+
+// Cam edges needed to confirm the phase
+#define CAM_CONFIRM 2
+
+// Outputs armed by the decoder on every tooth
+#define DECODER_MAX_OUTPUTS 8
+
+// Misfire detection, one combustion segment per cylinder
+#define DECODER_MAX_CYLINDERS 8
+
+// GlobalState keeps one entry per output and per cylinder
+static_assert(sizeof(GlobalState::output_stats) / sizeof(OutputStats) == DECODER_MAX_OUTPUTS,
+              "output_stats must match DECODER_MAX_OUTPUTS");
+static_assert(sizeof(GlobalState::crank_roughness) / sizeof(uint16_t) == DECODER_MAX_CYLINDERS,
+              "crank_roughness must match DECODER_MAX_CYLINDERS");
+static_assert(sizeof(GlobalState::misfires) / sizeof(uint32_t) == DECODER_MAX_CYLINDERS,
+              "misfires must match DECODER_MAX_CYLINDERS");
+
+struct DecoderOutput
+{
+    Trigger *trig = nullptr;
+    Coil *coil = nullptr; // ignition, dwell from the battery voltage, at most the request pw
+    std::atomic<uint32_t> request{0}; // end angle << 16 | pw in us, 0=off
+};
+
+struct ToothEvent
+{
+    absolute_time_t ts;
+    uint input; // 0=crank, 1=cam
+};
 
 struct Decoder
 {
@@ -18,37 +77,152 @@ struct Decoder
     uint delta_prev;
     uint sync_step = 0;
     uint sync_count = 0;
-    volatile alarm_id_t timeout_alarm_id = 0;
-    queue_t queue;
-    uint pulse_angles[60];
+    int timeout_alarm_num = -1; // hardware alarm firing at next_timeout
+    GlobalState *state = nullptr;
+    SpscRing<ToothEvent, DECODER_RING_SIZE> ring;
+    WheelPattern wheel; // 24-1 cam wheel if not loaded before enable()
+    ToothLog tooth_log;
+    AngleClock angle_clock; // valid in full or provisional sync
+    bool irq_processing = false;
 
-    uint full_cycle_us;
-    libdivide::divider<uint> fast_d;
+    // Crank edge filter, follows the teeth as they are pushed: the main loop
+    // may be several teeth behind, the gap is the one after the last pushed
+    volatile uint32_t filter_cycle_us = 0; // full cycle x band fraction, 0 = no filtering
+    volatile uint filter_tooth = 0;        // wheel tooth of the last pushed crank edge
+    volatile uint32_t filter_rejects = 0;
+    absolute_time_t filter_last_ts = 0;
+    volatile uint32_t crank_pushed = 0;    // crank edges in the ring so far
+    uint32_t crank_processed = 0;          // crank edges out of the ring so far
+    FilterBand filter_bands[DECODER_FILTER_BANDS] = {
+        {400, 64},   // cranking, uneven compression strokes: 25%
+        {2000, 96},  // 37.5%
+        {0, 128},    // 50%
+    };
 
-    const uint N_PULSES = 24;
-    const uint N_MISSING = 1;
+    // Cam phase, only used with a crank wheel
+    uint cam_angle = 0;        // engine angle of the cam edge
+    uint cam_window = 0x1000;  // accepted cam edge error, 45 deg
+    uint cam_phase = 0;        // 0 or 0x8000, engine angle of the crank wheel origin
+    uint cam_confidence = 0;   // phase confirmed when >= CAM_CONFIRM
+    uint cam_revs_missed = 0;  // crank turns since the last valid cam edge
 
-    void enable(uint pin);
-    bool update(GlobalState* gs);
-    bool compute_target(Trigger *target, uint end_deg, uint pw);
+    // Fast start from the stop position, persisted or from the last stall
+    int fast_start_tooth = -1; // last tooth before the engine stopped, -1=unknown
+    bool provisional_start = false;
+    volatile bool stop_pending = false; // stop_tooth needs to be persisted once stopped
+    uint stop_tooth;
 
-private:
-    uint find_pulse(uint angle)
+    DecoderOutput outputs[DECODER_MAX_OUTPUTS];
+
+    // Outputs sorted by the tooth they are armed on. A crank wheel has two
+    // positions per tooth, one per crank turn. Rebuilt from the requests when
+    // one changes or the speed drifted, events of position p are
+    // event_output[event_first[p]] to event_output[event_first[p + 1] - 1].
+    uint8_t event_first[2 * WHEEL_MAX_TEETH + 1];
+    uint8_t event_output[DECODER_MAX_OUTPUTS];
+    uint8_t event_pos[DECODER_MAX_OUTPUTS] = {}; // position of each output + 1, 0=off
+    std::atomic<bool> events_dirty{true};
+    uint events_cycle_us = 0; // full_cycle_us the table was built with
+    uint outputs_busy = 0;    // outputs with a pulse not started or a coil dwelling, bit per output
+    volatile bool new_tooth = false;
+
+    // Crank speed per combustion segment, segment 0 starts at engine angle 0.
+    // Without cam phase, cylinders 360 deg apart share a segment.
+    uint n_cylinders = 4;
+    uint misfire_threshold = 200; // segment slowdown over its neighbours counted as misfire, 0.01 %
+    uint seg_current = 0;         // segment of the last tooth
+    uint seg_valid = 0;           // segment changes seen since sync
+    uint seg_judged;              // segment of seg_slowdown[1]
+    uint32_t seg_period;          // cycle time at the crank speed of the last boundary, 1 us
+    int32_t seg_slowdown[2];      // speed lost over the last two full segments, 0.01 %
+
+    uint full_cycle_us;
+    int cycle_trend = 0; // full_cycle_us change per tooth, 1/32 us
+    uint sync_step_prev = 0;
+
+    // pio_capture: time teeth with a PIO state machine instead of the GPIO IRQ
+    void enable(GlobalState *gs, uint pin, bool pio_capture = false);
+    void enable_cam(uint pin, uint angle);
+    // Run the sync state machine and arm the outputs from the tooth IRQ,
+    // update() only checks for timeouts
+    void enable_irq_processing();
+    void set_output(uint i, Trigger *trig)
+    {
+        outputs[i].trig = trig;
+    }
+    void set_output(uint i, Coil *coil)
     {
-        // find last pulse lower than angle
-        uint result = (N_PULSES - N_MISSING - 1);
-        if (angle > 0)
+        outputs[i].coil = coil;
+    }
+    // end_deg: engine angle of the end of the pulse, pw=0 disables the output
+    void request_output(uint i, uint end_deg, uint pw)
+    {
+        const uint32_t request = pw ? ((end_deg & 0xFFFF) << 16) | MIN(pw, 0xFFFFU) : 0;
+        outputs[i].request.store(request, std::memory_order_relaxed);
+        events_dirty.store(true, std::memory_order_release);
+    }
+    // Single producer: the capture IRQ, or a trace player off-target
+    void __not_in_flash_func(push_tooth)(absolute_time_t ts, uint input)
+    {
+        if (input != 0)
+        {
+            ring.push({ts, input});
+            return;
+        }
+        const uint tooth = wheel.next(filter_tooth);
+        if (ts - filter_last_ts < ((uint64_t)filter_cycle_us * wheel.tooth_span[tooth] >> 16))
+        {
+            // too early to be a tooth, drop before it reaches the sync logic
+            filter_rejects = filter_rejects + 1;
+            return;
+        }
+        if (ring.push({ts, input}))
         {
-            while (angle <= pulse_angles[result])
-            {
-                result -= 1;
-            }
+            filter_last_ts = ts;
+            filter_tooth = tooth;
+            crank_pushed = crank_pushed + 1;
         }
-        return result;
+    }
+    void fast_start(uint tooth)
+    {
+        fast_start_tooth = tooth;
+    }
+    // True once per stop, when no tooth came for DECODER_STOP_US after a
+    // stall in sync: stop_tooth is then worth persisting
+    bool check_stop(absolute_time_t now);
+    bool update(GlobalState* gs);
+    // scheduled: arm now, the event table picked this tooth. Otherwise arm
+    // only from the last tooth before the start of the pulse
+    bool compute_target(Trigger *target, uint end_deg, uint pw, bool scheduled = false);
+
+    void drain(GlobalState *gs);
+    // engine stopped: cancel all pending outputs and reset the sync
+    void stall(GlobalState *gs);
+
+private:
+    void set_timeout_alarm(absolute_time_t t);
+    uint32_t timeout_us(uint32_t delta, uint tooth);
+    void build_events(const uint *cur, uint n_cur);
+    void arm_output(uint i);
+    uint output_pw(uint i, uint32_t request);
+    void retarget_output(uint i);
+    void arm_events(uint pos);
+    absolute_time_t end_time(uint end_deg);
+    void arm_outputs();
+    void process_tooth(GlobalState *gs, absolute_time_t ts_now);
+    void process_cam(GlobalState *gs, absolute_time_t ts_now);
+    void next_crank_turn(GlobalState *gs);
+    void update_misfire(GlobalState *gs, uint32_t delta);
+    int angle_to_us(int angle);
+    bool phased()
+    {
+        // a cam wheel always knows its phase
+        return (wheel.revs == 2) || (cam_confidence >= CAM_CONFIRM);
     }
     uint get_rpm()
     {
-        return 0x8000U / fast_d;
+        // 1 cycle = 720 deg, single hardware divide
+        return full_cycle_us ? 120'000'000U / full_cycle_us : 0;
     }
 };
 
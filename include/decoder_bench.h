@@ -0,0 +1,114 @@
+#ifndef __DECODER_BENCH_H__
+#define __DECODER_BENCH_H__
+
+#include <cstdint>
+
+#include "pico/stdlib.h"
+
+#include "libdivide.h"
+
+#include "decoder.h"
+
+// Decoder::update() cost per tooth, 36-1 wheel at 6000 rpm, no outputs.
+// Also times the libdivide divider the decoder rebuilt on every tooth
+// before get_rpm() used the hardware divide, the cost that was removed, and
+// the tooth log capture done on every event, and the angle clock queries
+// against the same angle and time computed from the last tooth.
+// Built with DECODER_BENCH on target, and by the host tests.
+struct DecoderBenchResult
+{
+    uint32_t update;    // counter ticks per tooth, update() of the tooth
+    uint32_t libdivide; // counter ticks per tooth, divider and 0x8000 / d
+    uint32_t empty;     // counter ticks of an empty measurement, included above
+    uint32_t log_64;    // counter ticks of 64 ToothLog::add(), empty included
+    // counter ticks of 16 queries, empty included
+    uint32_t now_angle_16;     // AngleClock::now_angle()
+    uint32_t angle_divide_16;  // angle from the last tooth, 64-bit divide by the cycle time
+    uint32_t to_time_16;       // AngleClock::angle_to_time()
+    uint32_t time_tooth_16;    // time from the last tooth, trend-corrected like compute_target()
+};
+
+// dec: not enabled, no timeout alarm. counter: free-running up counter,
+// counter_mask: its wrap
+template <typename Counter>
+static DecoderBenchResult decoder_bench(Decoder &dec, GlobalState &gs, uint n_teeth, Counter counter, uint32_t counter_mask)
+{
+    dec.wheel.missing_tooth(36, 1, 1);
+    uint64_t update = 0, divide = 0, empty = 0, log = 0;
+    uint64_t now_angle = 0, angle_divide = 0, to_time = 0, time_tooth = 0;
+    volatile uint speed;
+    volatile uint sink;
+    absolute_time_t ts = get_absolute_time();
+    uint tooth = 0;
+    for (uint i = 0; i < n_teeth; i++)
+    {
+        // 6000 rpm, 277.8 us per tooth, the gap is two
+        ts += (tooth == 0) ? 556 : 278;
+        tooth = dec.wheel.next(tooth);
+        dec.push_tooth(ts, 0);
+
+        uint32_t c0 = counter();
+        dec.update(&gs);
+        update += (counter() - c0) & counter_mask;
+
+        c0 = counter();
+        const libdivide::divider<uint> fast_d(dec.full_cycle_us ? dec.full_cycle_us : 1);
+        speed = 0x8000U / fast_d;
+        divide += (counter() - c0) & counter_mask;
+
+        c0 = counter();
+        empty += (counter() - c0) & counter_mask;
+
+        c0 = counter();
+        for (uint k = 0; k < 64; k++)
+            dec.tooth_log.add(278, k, 3, TOOTH_LOG_SYNC);
+        log += (counter() - c0) & counter_mask;
+
+        // queries between this tooth and the next, once synced, sink keeps them
+        if (dec.sync_step != 3)
+            continue;
+        uint angle = 0;
+        absolute_time_t t = 0;
+        c0 = counter();
+        for (uint k = 0; k < 16; k++)
+        {
+            dec.angle_clock.now_angle(ts + k * 17, angle);
+            sink = angle;
+        }
+        now_angle += (counter() - c0) & counter_mask;
+
+        const uint tooth_angle = dec.wheel.tooth_angle[dec.sync_count];
+        c0 = counter();
+        for (uint k = 0; k < 16; k++)
+        {
+            const uint64_t since = ts + k * 17 - dec.ts_prev;
+            sink = (tooth_angle + (uint)((since << 16) / dec.full_cycle_us)) & (dec.wheel.wheel_angle - 1);
+        }
+        angle_divide += (counter() - c0) & counter_mask;
+
+        c0 = counter();
+        for (uint k = 0; k < 16; k++)
+        {
+            dec.angle_clock.angle_to_time(k * 0x100, t);
+            sink = t;
+        }
+        to_time += (counter() - c0) & counter_mask;
+
+        c0 = counter();
+        for (uint k = 0; k < 16; k++)
+        {
+            const int angle = (k * 0x100 - tooth_angle) & (dec.wheel.wheel_angle - 1);
+            const int64_t n_teeth_q8 = (int64_t)angle * dec.wheel.cycle_mult[dec.wheel.hunt_tooth] >> 16;
+            const int64_t cycle_us = dec.full_cycle_us + ((dec.cycle_trend * (n_teeth_q8 + 256)) >> 14);
+            sink = dec.ts_prev + ((angle * cycle_us) >> 16);
+        }
+        time_tooth += (counter() - c0) & counter_mask;
+    }
+    (void)speed;
+    (void)sink;
+    return {(uint32_t)(update / n_teeth), (uint32_t)(divide / n_teeth), (uint32_t)(empty / n_teeth),
+            (uint32_t)(log / n_teeth), (uint32_t)(now_angle / n_teeth), (uint32_t)(angle_divide / n_teeth),
+            (uint32_t)(to_time / n_teeth), (uint32_t)(time_tooth / n_teeth)};
+}
+
+#endif // __DECODER_BENCH_H__
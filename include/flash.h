@@ -17,11 +17,11 @@ static int safe_flash_range_erase(size_t offset)
         uint32_t offset = (uint32_t)args;
         flash_range_erase(offset, FLASH_SECTOR_SIZE);
     };
-    return flash_safe_execute(call_flash_range_erase, &offset, UINT32_MAX);
+    return flash_safe_execute(call_flash_range_erase, (void *)offset, UINT32_MAX);
 }
 
 // This function will be called when it's safe to call flash_range_program
-static int safe_flash_range_program(size_t offset)
+static int safe_flash_range_program(size_t offset, const uint8_t *data)
 {
     void (*call_flash_range_program)(void *) = [](void *args)
     {
@@ -29,7 +29,8 @@ static int safe_flash_range_program(size_t offset)
         const uint8_t *data = (const uint8_t *)((uintptr_t *)args)[1];
         flash_range_program(offset, data, FLASH_PAGE_SIZE);
     };
-    return flash_safe_execute(call_flash_range_program, &offset, UINT32_MAX);
+    uintptr_t args[] = {offset, (uintptr_t)data};
+    return flash_safe_execute(call_flash_range_program, args, UINT32_MAX);
 }
 
 #endif // __FLASH_H__
\ No newline at end of file
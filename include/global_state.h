@@ -3,6 +3,8 @@
 
 #include <cstdint>
 
+#include "output_stats.h"
+
 struct GlobalState
 {
     uint16_t adc[7];
@@ -14,10 +16,28 @@ struct GlobalState
     int16_t battery_voltage;      // 0.01 V
     int16_t pico_temperature;     // 0.1 °C
     uint16_t engine_speed;        // 1 rpm
+    uint16_t ve;                  // ve_table at engine_speed and manifold_pressure
+    uint16_t afr_target;          // afr_table, same point
+    uint16_t advance;             // adv_table, same point
     uint32_t loop_time_max;       // 1 us
     uint32_t loop_time_avg;       // 1 us
     uint32_t avr_loop_time;       // 1 us
+    uint32_t arm_latency_max;     // 1 us, tooth edge to outputs armed
+    uint32_t arm_latency_avg;     // 1 us
+    uint32_t stall_latency;       // 1 us, last tooth to outputs shut down
+    uint32_t output_jitter;       // 1 ns, worst edge error of the loopback test
+    uint32_t output_retargets;    // 1 pulse, pending pulse moved by a fresher tooth
+    uint32_t output_late;         // 1 pulse, fresher tooth came after the pulse started
     uint64_t rev_count;           // 1 rev
+    uint32_t tooth_overflows;     // 1 tooth, lost before update()
+    uint32_t tooth_rejects;       // 1 edge, rejected by the noise filter
+    bool cam_sync;                // 720 deg phase known, sequential outputs
+    uint32_t cam_noise;           // 1 edge, outside of window or contradicting
+    uint32_t cam_losses;          // 1 loss, no cam edge for a full cycle
+    uint32_t fast_start_aborts;   // 1 start, stop position did not match the wheel
+    uint16_t crank_roughness[8];  // 0.01 %, per cylinder crank slowdown, rolling
+    uint32_t misfires[8];         // 1 stroke, per cylinder
+    OutputStats output_stats[8];  // per decoder output, copied by the main loop
 };
 
 #endif // __GLOBAL_STATE_H__
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef INJECTOR_H
+#define INJECTOR_H
+
+#include "pico/stdlib.h"
+
+#include "linear_interp.h"
+
+#define INJECTOR_CURVE_SIZE 6
+
+// Injector model between the fuel calculation and the output: turns the
+// wanted open time into the pulse width to drive the injector with.
+class Injector
+{
+    int16_t dead_voltage_last = INT16_MIN; // battery voltage of the cached dead time
+    uint dead_last = 0;
+    size_t small_bin = 0; // last bin of the short-pulse curve
+
+public:
+    // Dead time against battery voltage, the injector opens later as voltage drops
+    int16_t dead_voltage[INJECTOR_CURVE_SIZE] = {800, 1000, 1200, 1300, 1400, 1600}; // 0.01 V
+    uint16_t dead_table[INJECTOR_CURVE_SIZE] = {1800, 1300, 1000, 900, 800, 650};    // 1 us
+    // Short pulses do not open the injector fully, open time to ask for to get
+    // the wanted one. Unchanged past the last point.
+    int16_t small_pw[INJECTOR_CURVE_SIZE] = {0, 250, 500, 750, 1000, 1500};       // 1 us wanted
+    uint16_t small_table[INJECTOR_CURVE_SIZE] = {0, 380, 610, 830, 1050, 1500};   // 1 us asked
+    uint8_t min_duty = 0;   // 1/256 of the injection period
+    uint8_t max_duty = 218; // 1/256 of the injection period, 85%
+
+    // One caller at a time, the cached lookups are not shared.
+    // pw: wanted open time in us, 0 to skip the injection.
+    // period: time between two injections of this output in us.
+    uint pulse(uint pw, int16_t battery_voltage, uint period)
+    {
+        if (pw == 0)
+            return 0;
+
+        // battery voltage moves slowly, most calls reuse the last dead time
+        if (battery_voltage != dead_voltage_last)
+        {
+            dead_last = linear_interp(dead_voltage, INJECTOR_CURVE_SIZE, dead_table, battery_voltage);
+            dead_voltage_last = battery_voltage;
+        }
+
+        if (pw < (uint)small_pw[INJECTOR_CURVE_SIZE - 1])
+            pw = linear_interp(small_pw, INJECTOR_CURVE_SIZE, small_table, (int16_t)pw, &small_bin);
+        pw += dead_last;
+
+        const uint pw_min = (uint)(((uint64_t)period * min_duty) >> 8);
+        const uint pw_max = (uint)(((uint64_t)period * max_duty) >> 8);
+        return MIN(MAX(pw, pw_min), pw_max);
+    }
+    // Curves changed, drop the cached lookups
+    void reload()
+    {
+        dead_voltage_last = INT16_MIN;
+    }
+};
+
+#endif // INJECTOR_H
@@ -4,18 +4,87 @@
 #include <cstdint>
 #include <stdio.h>
 
+#include "pico/stdlib.h"
+
+#if PICO_ON_DEVICE
 #include "hardware/interp.h"
 
+inline bool linear_interp_ready[NUM_CORES];
+
+// Blend mode on interp0 and interp1 of the calling core. Each core has its
+// own interpolators, InterpBlend sets them up on first use.
 static void linear_interp_init()
 {
-    interp_config cfg = interp_default_config();
-    interp_config_set_blend(&cfg, true);
-    interp_set_config(interp0, 0, &cfg);
+    interp_hw_t *const hws[] = {interp0, interp1};
+    for (interp_hw_t *hw : hws)
+    {
+        interp_config cfg = interp_default_config();
+        interp_config_set_blend(&cfg, true);
+        interp_set_config(hw, 0, &cfg);
 
-    cfg = interp_default_config();
-    interp_set_config(interp0, 1, &cfg);
+        cfg = interp_default_config();
+        interp_set_config(hw, 1, &cfg);
+    }
+    linear_interp_ready[get_core_num()] = true;
+}
+
+// Interpolator for one lookup. Thread mode uses interp0 of the calling core,
+// interrupt handlers interp1, saved and restored so that handlers may nest.
+class InterpBlend
+{
+    interp_hw_t *hw;
+    interp_hw_save_t saved;
+    bool in_irq;
+
+public:
+    InterpBlend()
+    {
+        if (!linear_interp_ready[get_core_num()])
+            linear_interp_init();
+        in_irq = (__get_current_exception() != 0);
+        hw = in_irq ? interp1 : interp0;
+        if (in_irq)
+            interp_save(hw, &saved);
+    }
+    ~InterpBlend()
+    {
+        if (in_irq)
+            interp_restore(hw, &saved);
+    }
+    void alpha(uint32_t alpha)
+    {
+        hw->accum[1] = alpha;
+    }
+    // base01: first value in the low half, second in the high half
+    uint16_t blend(uint32_t base01)
+    {
+        hw->base01 = base01;
+        return hw->peek[1];
+    }
+};
+#else
+static inline void linear_interp_init()
+{
 }
 
+// Same results as the interpolator blend mode, for host builds
+class InterpBlend
+{
+    uint32_t a = 0;
+
+public:
+    void alpha(uint32_t alpha)
+    {
+        a = alpha & 0xFF;
+    }
+    uint16_t blend(uint32_t base01)
+    {
+        const uint32_t base0 = base01 & 0xFFFF, base1 = base01 >> 16;
+        return base0 + (((int32_t)(base1 - base0) * (int32_t)a) >> 8);
+    }
+};
+#endif
+
 // binary search on the axis
 template <typename T = int16_t>
 static size_t find_bin(const T *axis, size_t n, T v)
@@ -32,25 +101,48 @@ static size_t find_bin(const T *axis, size_t n, T v)
     return lo;
 }
 
+template <typename T = int16_t>
+static bool in_bin(const T *axis, size_t n, T v, size_t bin)
+{
+    return (bin <= n - 2) && ((bin == 0) || (v >= axis[bin])) && ((bin == n - 2) || (v < axis[bin + 1]));
+}
+
+// hint: bin of the last lookup on this axis, start at 0. Inputs move slowly,
+// the bin or one of its neighbours usually matches before a full search.
+template <typename T = int16_t>
+static size_t find_bin(const T *axis, size_t n, T v, size_t *hint)
+{
+    size_t bin = *hint;
+    if (in_bin(axis, n, v, bin))
+        return bin;
+    if (in_bin(axis, n, v, bin + 1))
+        bin = bin + 1;
+    else if ((bin > 0) && in_bin(axis, n, v, bin - 1))
+        bin = bin - 1;
+    else
+        bin = find_bin(axis, n, v);
+    *hint = bin;
+    return bin;
+}
+
 template <typename T = int16_t>
 static uint16_t linear_interp(
     const T *x_axis, size_t nx,
     const uint16_t *table,
-    T x)
+    T x, size_t *x_hint = nullptr)
 {
     // 514 ns (77 ops) per call
     // Clamp inside valid range
     x = MIN(MAX(x, x_axis[0]), x_axis[nx - 1] - 1);
 
-    size_t ix = find_bin(x_axis, nx, x);
+    size_t ix = x_hint ? find_bin(x_axis, nx, x, x_hint) : find_bin(x_axis, nx, x);
 
     T x0 = x_axis[ix];
     T x1 = x_axis[ix + 1];
 
-    interp0->accum[1] = 256U * (x - x0) / (x1 - x0);
-    interp0->base01 = *(uint32_t *)(table + ix);
-    // printf("x:%d, y:%d\n", x, interp0->peek[1]);
-    return interp0->peek[1];
+    InterpBlend interp;
+    interp.alpha(256U * (x - x0) / (x1 - x0));
+    return interp.blend(*(uint32_t *)(table + ix));
 }
 
 template <typename T = int16_t>
@@ -58,34 +150,30 @@ static uint16_t bilinear_interp(
     const T *x_axis, size_t nx,
     const T *y_axis, size_t ny,
     const uint16_t *table,
-    T x, T y)
+    T x, T y, size_t *x_hint = nullptr, size_t *y_hint = nullptr)
 {
     // 827 ns (124 ops) per call
     // Clamp inside valid range
     x = MIN(MAX(x, x_axis[0]), x_axis[nx - 1] - 1);
     y = MIN(MAX(y, y_axis[0]), y_axis[ny - 1] - 1);
 
-    size_t ix = find_bin(x_axis, nx, x);
-    size_t iy = find_bin(y_axis, ny, y);
+    size_t ix = x_hint ? find_bin(x_axis, nx, x, x_hint) : find_bin(x_axis, nx, x);
+    size_t iy = y_hint ? find_bin(y_axis, ny, y, y_hint) : find_bin(y_axis, ny, y);
 
     T x0 = x_axis[ix];
     T x1 = x_axis[ix + 1];
     T y0 = y_axis[iy];
     T y1 = y_axis[iy + 1];
 
-    interp0->accum[1] = 256U * (x - x0) / (x1 - x0); // alpha on the x axis
+    InterpBlend interp;
+    interp.alpha(256U * (x - x0) / (x1 - x0)); // alpha on the x axis
 
     size_t offset = iy * nx + ix;
-    interp0->base01 = *(uint32_t *)(table + offset); // blend on first row
-    uint16_t a = interp0->peek[1];
-
-    interp0->base01 = *(uint32_t *)(table + offset + nx); // blend on second row
-    uint16_t b = interp0->peek[1];
+    uint16_t a = interp.blend(*(uint32_t *)(table + offset));      // blend on first row
+    uint16_t b = interp.blend(*(uint32_t *)(table + offset + nx)); // blend on second row
 
-    interp0->accum[1] = 256U * (y - y0) / (y1 - y0); // alpha on the y axis
-    interp0->base[0] = a;                            // blend of the final value
-    interp0->base[1] = b;
-    return interp0->peek[1];
+    interp.alpha(256U * (y - y0) / (y1 - y0)); // alpha on the y axis
+    return interp.blend(a | ((uint32_t)b << 16)); // blend of the final value
 }
 
 #endif // __BILINTERP_H__
@@ -0,0 +1,33 @@
+#ifndef __OUTPUT_STATS_H__
+#define __OUTPUT_STATS_H__
+
+#include <cstdint>
+
+// Histogram buckets, bucket b counts callbacks b bits of us late:
+// 0 = on time, 1 = 1 us, 2 = 2-3 us, ... the last one takes the rest
+#define OUTPUT_STATS_BUCKETS 12
+// Callback lateness counted as late, 1 us
+#define OUTPUT_STATS_LATE_US 20
+
+// Edge timing of one output channel: how long after its scheduled time each
+// alarm callback ran. Written from the alarm callbacks, read anywhere.
+struct OutputStats
+{
+    uint32_t hist[OUTPUT_STATS_BUCKETS] = {}; // 1 callback
+    uint32_t max_late = 0;                    // 1 us
+    uint32_t late = 0;                        // 1 callback, past OUTPUT_STATS_LATE_US
+    uint32_t missed = 0;                      // 1 pulse, start callback past its end
+    uint32_t rejected = 0;                    // 1 pulse, refused when queued
+
+    void add(uint32_t late_us)
+    {
+        const unsigned b = late_us ? 32 - __builtin_clz(late_us) : 0;
+        hist[(b < OUTPUT_STATS_BUCKETS) ? b : OUTPUT_STATS_BUCKETS - 1] += 1;
+        if (late_us > max_late)
+            max_late = late_us;
+        if (late_us > OUTPUT_STATS_LATE_US)
+            late += 1;
+    }
+};
+
+#endif // __OUTPUT_STATS_H__
@@ -0,0 +1,28 @@
+#ifndef __PIO_OUTPUT_H__
+#define __PIO_OUTPUT_H__
+
+#include <cstdint>
+
+#include "pico/stdlib.h"
+
+// Output edges generated by a PIO state machine. The alarm fires
+// PIO_OUTPUT_LEAD_US before the pulse, the delay left is then pushed to the
+// state machine aligned on a 1 us timer tick: alarm and IRQ latency no longer
+// move the edges.
+#define PIO_OUTPUT_LEAD_US 20
+
+// Claim a state machine driving the pin, -1 if none is free
+int pio_output_claim(uint pin);
+// Queue one pulse, called at most PIO_OUTPUT_LEAD_US before `start`.
+// after: end of the previous pulse, the state machine counts the delay from
+// there if it is still running. Back to back pulses get a 5 clocks low gap.
+void pio_output_fire(uint sm, absolute_time_t start, uint pw, absolute_time_t after = 0);
+// Abort a queued or running pulse, the pin goes low
+void pio_output_stop(uint sm);
+
+// Loopback test mode: fire n pulses `period` us apart through the alarm pool,
+// capture the pin with a second state machine and return the largest error
+// between requested and actual edge intervals, in ns. UINT32_MAX on failure.
+uint32_t pio_output_loopback(uint sm, uint pin, uint n, uint period, uint pw);
+
+#endif // __PIO_OUTPUT_H__
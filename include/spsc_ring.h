@@ -0,0 +1,65 @@
+#ifndef __SPSC_RING_H__
+#define __SPSC_RING_H__
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer / single-consumer ring buffer.
+// push() is called from a single producer (usually an IRQ handler),
+// pop() from a single consumer (usually the main loop).
+// N must be a power of 2.
+template <typename T, uint32_t N>
+struct SpscRing
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "ring size must be a power of 2");
+
+    T items[N];
+    std::atomic<uint32_t> head{0};      // next slot to write, owned by producer
+    std::atomic<uint32_t> tail{0};      // next slot to read, owned by consumer
+    std::atomic<uint32_t> overflows{0}; // items dropped because the ring was full
+
+    bool push(const T &item)
+    {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= N)
+        {
+            // consumer is too slow, drop the newest item
+            overflows.store(overflows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        items[h % N] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        const uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+        {
+            return false; // empty
+        }
+        item = items[t % N];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, look at the oldest item without removing it
+    bool peek(T &item) const
+    {
+        const uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+        {
+            return false; // empty
+        }
+        item = items[t % N];
+        return true;
+    }
+
+    uint32_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+};
+
+#endif // __SPSC_RING_H__
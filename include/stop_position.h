@@ -0,0 +1,20 @@
+#ifndef __STOP_POSITION_H__
+#define __STOP_POSITION_H__
+
+#include <cstdint>
+
+#include "pico/stdlib.h"
+
+// Last tooth seen before the engine stopped, kept in flash for a fast restart.
+// n_teeth identifies the wheel the record was taken with.
+// A full sector is erased by stop_position_init() only, at boot before the
+// watchdog runs: a 4 KB sector erase takes 45 ms typically and up to 400 ms
+// on the W25Q flash, over the 100 ms watchdog. A save programs one page,
+// 0.4 ms typically and up to 3 ms.
+void stop_position_init();
+bool stop_position_load(uint n_teeth, uint *tooth);
+// false once the sector is full: the last record is invalidated, the next
+// start syncs without a stop position
+bool stop_position_save(uint n_teeth, uint tooth);
+
+#endif // __STOP_POSITION_H__
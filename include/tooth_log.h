@@ -0,0 +1,65 @@
+#ifndef __TOOTH_LOG_H__
+#define __TOOTH_LOG_H__
+
+#include <atomic>
+#include <cstdint>
+
+#include "pico/stdlib.h"
+
+// Number of logged events, must be a power of 2
+#define TOOTH_LOG_SIZE 256
+
+#define TOOTH_LOG_CAM 0x01    // cam edge, crank tooth otherwise
+#define TOOTH_LOG_SYNC 0x02   // decoder in full sync
+#define TOOTH_LOG_OUTPUT 0x04 // an output was armed on this tooth
+
+struct ToothLogEntry
+{
+    uint32_t period; // 1 us since previous crank tooth
+    uint8_t tooth;
+    uint8_t sync_step;
+    uint8_t flags;
+};
+
+// Fixed RAM ring of the last decoder events, written by the decoder and
+// read from the other core without stopping it.
+struct ToothLog
+{
+    ToothLogEntry entries[TOOTH_LOG_SIZE];
+    std::atomic<uint32_t> head{0};
+
+    void add(uint32_t period, uint tooth, uint sync_step, uint flags)
+    {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        ToothLogEntry &e = entries[h % TOOTH_LOG_SIZE];
+        e.period = period;
+        e.tooth = tooth;
+        e.sync_step = sync_step;
+        e.flags = flags;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    void mark_output()
+    {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        entries[(h - 1) % TOOTH_LOG_SIZE].flags |= TOOTH_LOG_OUTPUT;
+    }
+
+    // Copy up to n entries, oldest first, skipping the first `first` ones.
+    // The oldest entries may be overwritten while they are copied.
+    uint read(ToothLogEntry *out, uint first, uint n) const
+    {
+        const uint32_t h = head.load(std::memory_order_acquire);
+        const uint32_t count = (h < TOOTH_LOG_SIZE) ? h : TOOTH_LOG_SIZE;
+        if (first >= count)
+            return 0;
+        if (n > count - first)
+            n = count - first;
+        const uint32_t start = h - count + first;
+        for (uint i = 0; i < n; i++)
+            out[i] = entries[(start + i) % TOOTH_LOG_SIZE];
+        return n;
+    }
+};
+
+#endif // __TOOTH_LOG_H__
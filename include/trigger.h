@@ -1,72 +1,205 @@
 #ifndef TRIGGER_H
 #define TRIGGER_H
 
+#include <atomic>
 #include <stdio.h>
 #include "pico/stdlib.h"
-#include "pico/sem.h"
 
+#include "output_stats.h"
+#include "pio_output.h"
+#include "spsc_ring.h"
+
+// Pulses queued per output, must be a power of 2
+#define TRIGGER_QUEUE_SIZE 4
+
+struct TriggerPulse
+{
+    absolute_time_t start;
+    uint pw;
+};
+
+// Output channel. update() queues pulses, a single alarm chain outputs them
+// in order: each alarm callback sets the edge and reschedules itself for the
+// next one. Adjacent pulses are chained without a low gap.
 class Trigger
 {
-    bool running;
-    semaphore_t sem;
+    SpscRing<TriggerPulse, TRIGGER_QUEUE_SIZE> queue; // update() -> alarm callback
+    std::atomic<bool> active{false};                  // alarm chain running
+    absolute_time_t queued_end = 0;                   // end of the last queued pulse
+
+    // alarm callback side
+    volatile bool in_callback = false;
+    bool running = false; // pin high
+    TriggerPulse cur;     // pulse being output
+    absolute_time_t pio_end = 0;
+
     uint32_t pin_mask;
-    uint pw;
-    absolute_time_t current_pulse_end;
+    alarm_id_t alarm_id = 0;
+    absolute_time_t alarm_at = 0; // target of the pending alarm
+    int pio_sm = -1; // PIO output, -1=edges set by the alarm callback
 
 public:
-    void init(uint pin)
+    OutputStats stats;
+
+    // pio: edges generated by a PIO state machine, falls back to the
+    // alarm callback if none is free
+    void init(uint pin, bool pio = false)
     {
         pin_mask = (1<<pin);
         gpio_init(pin);
         gpio_set_dir(pin, GPIO_OUT);
-
-        sem_init(&sem, 1, 1);
+        if (pio)
+            pio_sm = pio_output_claim(pin);
     }
+    // Single producer. Pulses must come in order, a pulse overlapping the
+    // last queued one is rejected, one starting at its end extends it.
     bool update(absolute_time_t next_event, uint next_pw)
     {
-        if (next_event < current_pulse_end)
-        {
-            // prevent creating new alarm before end of current pulse
+        if (next_pw == 0)
             return false;
-        }
-        if (!sem_try_acquire(&sem))
+        if ((next_event < queued_end) || !queue.push({next_event, next_pw}))
         {
-            // block update() while alarm is pending
+            stats.rejected += 1; // overlap or queue full
             return false;
         }
+        queued_end = next_event + next_pw;
 
-        current_pulse_end = next_event + next_pw;
-        pw = next_pw;
-        add_alarm_at(next_event, Trigger::callback, this, true);
+        // start the alarm chain if it is idle
+        bool idle = false;
+        if (active.compare_exchange_strong(idle, true))
+        {
+            alarm_at = (pio_sm >= 0) ? next_event - PIO_OUTPUT_LEAD_US : next_event;
+            alarm_id = add_alarm_at(alarm_at, Trigger::callback, this, true);
+        }
         return true;
     }
+    // A queued pulse has not started yet
+    bool pending()
+    {
+        return queue.size() > 0;
+    }
+    // Move the pending pulse to a fresher estimate. Only while it is the
+    // single pulse queued and its start alarm can still be cancelled, so it
+    // fires exactly once. Same producer as update().
+    // Returns 1 if moved, 0 if unchanged, -1 if too late to move.
+    int retarget(absolute_time_t next_event, uint next_pw)
+    {
+        TriggerPulse p;
+        if (in_callback || running || (queue.size() != 1) || !queue.peek(p))
+            return -1;
+        if ((p.start == next_event) && (p.pw == next_pw))
+            return 0;
+        if (!cancel_alarm(alarm_id))
+            return -1; // alarm fired meanwhile
+        // the callback cannot run anymore, the queue is ours
+        queue.pop(p);
+        queue.push({next_event, next_pw});
+        queued_end = next_event + next_pw;
+        alarm_at = (pio_sm >= 0) ? next_event - PIO_OUTPUT_LEAD_US : next_event;
+        alarm_id = add_alarm_at(alarm_at, Trigger::callback, this, true);
+        return 1;
+    }
+    // Drop the queued pulses and cut the running one short.
+    // Interrupts must be disabled, the alarm callback must not run meanwhile.
+    void cancel()
+    {
+        if (active)
+            cancel_alarm(alarm_id);
+        if (running)
+        {
+            gpio_clr_mask(pin_mask);
+            running = false;
+        }
+        if (pio_sm >= 0)
+            pio_output_stop(pio_sm); // may already be queued in the state machine
+        pio_end = 0; // nothing left to wait for, the next pulse times from now
+        TriggerPulse p;
+        while (queue.pop(p))
+            ;
+        active = false;
+        alarm_id = 0;
+        queued_end = 0;
+    }
     void print_debug()
     {
-        printf("trigger:%d+%d;", current_pulse_end, pw);
+        printf("trigger:%llu+%lu;", (unsigned long long)queued_end, (unsigned long)queue.size());
     }
 
 private:
+    // next alarm, in us after the one running, 0 to end the chain
+    int64_t __not_in_flash_func(next_alarm)(absolute_time_t now_target)
+    {
+        TriggerPulse next;
+        if (!queue.peek(next))
+        {
+            active = false;
+            // update() may have queued a pulse before the chain was released
+            bool idle = false;
+            if (!queue.peek(next) || !active.compare_exchange_strong(idle, true))
+                return 0;
+        }
+        const absolute_time_t next_target = (pio_sm >= 0) ? next.start - PIO_OUTPUT_LEAD_US : next.start;
+        return MAX((int64_t)(next_target - now_target), 1);
+    }
+
     static int64_t __not_in_flash_func(callback)(alarm_id_t, void *data)
     {
         if (!data)
             return 0;
 
+        // the tooth IRQ may preempt the callback, retarget() must not touch the queue then
         Trigger *t = (Trigger *)data;
-        if (t->running)
+        t->in_callback = true;
+        const int64_t late = time_us_64() - t->alarm_at;
+        t->stats.add(MAX(late, 0));
+        const int64_t next = t->fire();
+        t->alarm_at -= next; // rescheduled after this target
+        t->in_callback = false;
+        return next;
+    }
+
+    int64_t __not_in_flash_func(fire)()
+    {
+        if (pio_sm >= 0)
         {
-            gpio_clr_mask(t->pin_mask);
-            t->running = false;
-            return 0;
+            // both edges from the state machine, after the previous pulse if still running
+            queue.pop(cur);
+            if (time_us_64() >= cur.start + cur.pw)
+            {
+                stats.missed += 1; // too late for any of the pulse
+                return -next_alarm(alarm_at);
+            }
+            pio_output_fire(pio_sm, cur.start, cur.pw, pio_end);
+            pio_end = cur.start + cur.pw;
+            return -next_alarm(alarm_at); // from the armed time, like the SDK
+        }
+        if (running)
+        {
+            const absolute_time_t end = cur.start + cur.pw;
+            TriggerPulse next;
+            if (queue.peek(next) && (next.start <= end))
+            {
+                // back to back, keep the pin high until the end of the next one
+                queue.pop(cur);
+                return -(int64_t)(cur.start + cur.pw - end);
+            }
+            gpio_clr_mask(pin_mask);
+            running = false;
+            return -next_alarm(end);
         }
         else
         {
-            gpio_set_mask(t->pin_mask);
-            t->running = true;
-            const uint pw = t->pw;
-            sem_release(&t->sem); // allow update(), alarm has fired
-            return -(int64_t)(pw);
+            queue.pop(cur);
+            if (time_us_64() >= cur.start + cur.pw)
+            {
+                stats.missed += 1; // too late for any of the pulse
+                return -next_alarm(alarm_at);
+            }
+            gpio_set_mask(pin_mask);
+            running = true;
+            return -(int64_t)(cur.pw);
         }
     }
 };
 
-#endif // TRIGGER_H
\ No newline at end of file
+#endif // TRIGGER_H
@@ -0,0 +1,48 @@
+#ifndef __WHEEL_PATTERN_H__
+#define __WHEEL_PATTERN_H__
+
+#include <cstdint>
+
+#include "pico/stdlib.h"
+
+#define WHEEL_MAX_TEETH 64
+
+// Trigger wheel description and the per-tooth tables derived from it.
+// Engine angles are in 1/0x10000 of a 720° cycle: a crank wheel covers 0x8000
+// per turn, a cam wheel 0x10000.
+// Tooth i is checked with the ratio between the gap before it and the gap
+// before tooth i-1, the tooth with the largest ratio is used to sync.
+struct WheelPattern
+{
+    uint n_teeth = 0;
+    uint revs;        // crank revolutions per wheel turn, 1=crank, 2=cam
+    uint wheel_angle; // engine angle of one wheel turn
+    uint key_tooth;   // tooth after the most distinctive gap
+    uint hunt_tooth;  // tooth used to estimate speed before sync
+
+    uint32_t tooth_angle[WHEEL_MAX_TEETH];  // engine angle of the tooth
+    uint32_t tooth_span[WHEEL_MAX_TEETH];   // engine angle of the gap before the tooth
+    uint32_t cycle_mult[WHEEL_MAX_TEETH];   // 0x10000 / gap before the tooth, Q8
+    uint32_t ratio_min[WHEEL_MAX_TEETH];    // accepted gap ratio, Q8
+    uint32_t ratio_max[WHEEL_MAX_TEETH];    // rejected gap ratio, Q8
+    uint32_t timeout_mult[WHEEL_MAX_TEETH]; // expected gap ratio + 25%, Q8
+    uint32_t crank_timeout_mult[WHEEL_MAX_TEETH]; // expected gap ratio x 2 when cranking, Q8
+
+    // angles: tooth positions in 1/0x10000 of a wheel turn, strictly increasing
+    bool load(const uint16_t *angles, uint n, uint wheel_revs);
+    bool missing_tooth(uint n_pulses, uint n_missing, uint wheel_revs);
+    bool plus_one(uint n_pulses, uint wheel_revs);
+
+    uint next(uint tooth) const
+    {
+        return (tooth + 1 < n_teeth) ? tooth + 1 : 0;
+    }
+    bool match(uint tooth, uint32_t delta, uint32_t delta_prev) const
+    {
+        const uint64_t delta_q8 = (uint64_t)delta << 8;
+        return (delta_q8 >= (uint64_t)delta_prev * ratio_min[tooth]) &&
+               (delta_q8 < (uint64_t)delta_prev * ratio_max[tooth]);
+    }
+};
+
+#endif // __WHEEL_PATTERN_H__
@@ -1,129 +1,542 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
-#include "pico/util/queue.h"
-#include "pico/sem.h"
+#include "hardware/sync.h"
 
 #include "decoder.h"
 #include "trigger.h"
 
-static queue_t *new_ts_queue;
-void __not_in_flash_func(new_ts_callback)(uint, uint32_t)
+void Decoder::drain(GlobalState *gs)
 {
-    const absolute_time_t new_ts = get_absolute_time();
-    queue_try_add(new_ts_queue, &new_ts);
+    // Drain every pending tooth, a slow main loop must not lose any
+    bool updated = false;
+    ToothEvent ev;
+    while (ring.pop(ev))
+    {
+        // the stall alarm must not reset the state in the middle of a tooth
+        const uint32_t status = save_and_disable_interrupts();
+        if (ev.input == 1)
+        {
+            process_cam(gs, ev.ts);
+        }
+        else
+        {
+            crank_processed += 1;
+            process_tooth(gs, ev.ts);
+            updated = true;
+        }
+        restore_interrupts(status);
+    }
+    gs->tooth_overflows = ring.overflows.load(std::memory_order_relaxed);
+    gs->tooth_rejects = filter_rejects;
+
+    // Update global state, once for all the teeth drained
+    if (updated)
+    {
+        gs->engine_speed = get_rpm();
+        new_tooth = true;
+    }
 }
 
-void Decoder::enable(uint pin)
+bool Decoder::update(GlobalState *gs)
 {
-    uint i;
-    for (i = 0; i < (N_PULSES - N_MISSING); i++)
-        pulse_angles[i] = i * 0x10000 / N_PULSES;
-    pulse_angles[i] = 0x10000;
+    if (!irq_processing)
+        drain(gs);
+
+    // keep the tooth IRQ out while the sync state is reset
+    const uint32_t status = save_and_disable_interrupts();
+    const bool updated = new_tooth;
+    new_tooth = false;
+    if (!updated && (get_absolute_time() > next_timeout) && (sync_step != 0))
+    {
+        // missed by the stall alarm, e.g. main loop too slow to re-arm it in time
+        stall(gs);
+    }
+    restore_interrupts(status);
+
+    // output edge timing, counters may move while copied
+    for (uint i = 0; i < DECODER_MAX_OUTPUTS; i++)
+    {
+        if (outputs[i].coil)
+            gs->output_stats[i] = outputs[i].coil->stats;
+        else if (outputs[i].trig)
+            gs->output_stats[i] = outputs[i].trig->stats;
+    }
 
-    new_ts_queue = &queue;
-    queue_init(&queue, sizeof(absolute_time_t), 1);
-    gpio_set_irq_enabled_with_callback(pin, GPIO_IRQ_EDGE_RISE, true, new_ts_callback);
+    return updated;
 }
 
-bool Decoder::update(GlobalState *gs)
+void Decoder::stall(GlobalState *gs)
 {
-    absolute_time_t ts_now;
-    if (queue_try_remove(&queue, &ts_now))
+    const uint32_t status = save_and_disable_interrupts();
+    if (sync_step != 0)
     {
-        uint32_t delta = ts_now - ts_prev;
-        uint32_t next_timeout_us = 0;
-        switch (sync_step)
+        // Lost sync, shut the outputs down first
+        for (uint i = 0; i < DECODER_MAX_OUTPUTS; i++)
+        {
+            if (outputs[i].trig)
+                outputs[i].trig->cancel();
+            if (outputs[i].coil)
+                outputs[i].coil->cancel();
+        }
+        outputs_busy = 0;
+        gs->engine_speed = 0;
+        gs->stall_latency = time_us_64() - ts_prev;
+
+        // remember where the engine stopped, a restart syncs from there
+        if (sync_step >= 3)
+        {
+            stop_tooth = sync_count;
+            stop_pending = true;
+            fast_start_tooth = sync_count;
+        }
+        filter_cycle_us = 0;
+        sync_step = 0;
+        cam_confidence = 0;
+        gs->cam_sync = false;
+        angle_clock.stop();
+    }
+    restore_interrupts(status);
+}
+
+bool Decoder::check_stop(absolute_time_t now)
+{
+    // a stall alone may be a main loop too slow, or the engine restarting
+    const uint32_t status = save_and_disable_interrupts();
+    const bool stopped = stop_pending && (sync_step == 0) && (now - ts_prev > DECODER_STOP_US);
+    if (stopped)
+        stop_pending = false;
+    restore_interrupts(status);
+    return stopped;
+}
+
+uint32_t Decoder::timeout_us(uint32_t delta, uint tooth)
+{
+    // hunting or provisional teeth may be the first ones of a start, assume cranking
+    const bool cranking = (sync_step != 3) || (full_cycle_us > 120'000'000U / DECODER_CRANKING_RPM);
+    return (uint64_t)delta * (cranking ? wheel.crank_timeout_mult[tooth] : wheel.timeout_mult[tooth]) >> 8;
+}
+
+void Decoder::process_tooth(GlobalState *gs, absolute_time_t ts_now)
+{
+    const uint32_t delta = ts_now - ts_prev;
+    uint32_t next_timeout_us = 0;
+    switch (sync_step)
+    {
+    case 0: // first timestamp
+        sync_step = 1;
+        sync_count = 0;
+        provisional_start = (fast_start_tooth >= 0);
+        if (provisional_start)
+        {
+            // assume the engine did not rock back since it stopped
+            sync_count = wheel.next(fast_start_tooth);
+            fast_start_tooth = -1;
+        }
+        next_timeout_us = 100'000; // 100ms
+        break;
+
+    case 1: // first delta
+        if (provisional_start)
+        {
+            // provisional sync, outputs can fire from this tooth
+            sync_step = 4;
+            sync_count = wheel.next(sync_count);
+            next_timeout_us = timeout_us(delta, wheel.next(sync_count));
+        }
+        else
         {
-        case 0: // first timestamp
-            sync_step = 1;
-            sync_count = 0;
-            // rpm = 50 (arbitrary target)
-            // n_pulses = 24 pulse/rotation
-            // n_cycles = 2 (1=crank, 2=cam)
-            // (60'000 / rpm / n_pulses * n_cycles) ms
-            next_timeout_us = 100'000; // 100ms
-            break;
-
-        case 1: // first delta
             sync_step = 2;
-            next_timeout_us = delta * 5 / 4; // normal pulse @ 125ms
-            break;
+            next_timeout_us = timeout_us(delta, wheel.key_tooth); // longest gap
+        }
+        break;
+
+    case 2: // wait for the key gap
+        if (wheel.match(wheel.key_tooth, delta, delta_prev))
+        {
+            sync_step = 3;
+            sync_count = wheel.key_tooth; // start new engine cycle
+            gs->rev_count += wheel.revs;
+            next_timeout_us = timeout_us(delta, wheel.next(sync_count));
+        }
+        else
+        {
+            next_timeout_us = timeout_us(delta, wheel.key_tooth);
+        }
+        break;
 
-        case 2:                               // confirm delta
-            if (delta > (delta_prev * 3 / 4)) // expect at least 75ms
+    case 3: // full sync, every gap must match the pattern
+    case 4: // provisional sync, confirmed on the key gap
+        sync_count = wheel.next(sync_count);
+        if (wheel.match(sync_count, delta, delta_prev))
+        {
+            if (sync_count == 0)
+                next_crank_turn(gs);
+            if (sync_count == wheel.key_tooth)
             {
                 sync_step = 3;
+                gs->rev_count += wheel.revs; // Increment revolution count
             }
-            next_timeout_us = delta * 10 / 4; // longer pulse @ 250ms
-            break;
+            next_timeout_us = timeout_us(delta, wheel.next(sync_count));
+        }
+        else
+        {
+            if (sync_step == 4)
+                gs->fast_start_aborts += 1;
+            sync_step = 2; // challenge failed, sync loss
+            cam_confidence = 0;
+            angle_clock.stop();
+            next_timeout_us = timeout_us(delta, wheel.key_tooth);
+        }
+        break;
 
-        case 3:                               // wait for longer delta
-            if (delta > (delta_prev * 7 / 4)) // expect at least 175ms
-            {
-                sync_step = 4;
-                sync_count = 0;                  // start new engine cycle
-                delta = (delta + 1) / 2;         // longer delta detected, divide by 2
-                next_timeout_us = delta * 5 / 4; // normal pulse @ 125ms
-            }
-            else
-            {
-                sync_count = 0;                   // challenge failed, sync loss
-                next_timeout_us = delta * 10 / 4; // longer pulse @ 250ms
-            }
-            break;
+    default:;
+    }
+    tooth_log.add(delta, sync_count, sync_step, (sync_step == 3) ? TOOTH_LOG_SYNC : 0);
 
-        case 4: // full sync
-            sync_count += 1;
-            if (sync_count >= (N_PULSES - N_MISSING - 1)) // 24 - 1 - 1 = 22
-            {
-                sync_step = 3;                    // challenge longer pulse
-                gs->rev_count += 2;               // Increment revolution count
-                next_timeout_us = delta * 10 / 4; // longer pulse @ 250ms
-            }
-            else
-            {
-                next_timeout_us = delta * 5 / 4; // normal pulse @ 125ms
-            }
-            break;
+    delta_prev = delta;
+    ts_prev = ts_now;
+    next_timeout = ts_now + next_timeout_us;
+    set_timeout_alarm(next_timeout);
+
+    // update timing variables
+    const uint tooth = (sync_step >= 3) ? sync_count : wheel.hunt_tooth;
+    const uint full_cycle_prev = full_cycle_us;
+    full_cycle_us = (uint64_t)delta * wheel.cycle_mult[tooth] >> 8;
+
+    // cycle time trend per tooth, only between two synced teeth
+    // filtered over ~32 teeth, the 1 us timestamp resolution makes it noisy.
+    // Kept in 1/32 us and rounded, a truncated division would never follow a
+    // trend smaller than its divisor.
+    if (DECODER_TREND_PREDICTION && (sync_step == 3) && (sync_step_prev == 3))
+    {
+        const int limit = full_cycle_us / 8;
+        const int trend = MIN(MAX((int)(full_cycle_us - full_cycle_prev), -limit), limit);
+        cycle_trend += trend - ((cycle_trend + 16) >> 5);
+    }
+    else
+    {
+        cycle_trend = 0;
+    }
+    sync_step_prev = sync_step;
 
-        default:;
+    // reject edges earlier than a fraction of the next expected gap
+    if (sync_step >= 3)
+    {
+        uint band = 0;
+        while ((band < DECODER_FILTER_BANDS - 1) && (gs->engine_speed > filter_bands[band].rpm))
+            band++;
+        // the teeth still in the ring moved the filter on past this one
+        uint tooth = sync_count;
+        for (uint32_t n = crank_pushed - crank_processed; n > 0; n--)
+            tooth = wheel.next(tooth);
+        filter_tooth = tooth;
+        filter_cycle_us = (uint64_t)full_cycle_us * filter_bands[band].fraction >> 8;
+    }
+    else
+    {
+        filter_cycle_us = 0;
+    }
+
+    if (sync_step == 3)
+        update_misfire(gs, delta);
+    else
+        seg_valid = 0;
+
+    if (sync_step >= 3)
+    {
+        const uint angle_mask = phased() ? 0xFFFF : (wheel.wheel_angle - 1);
+        angle_clock.set(ts_now, (phased() ? cam_phase : 0) + wheel.tooth_angle[sync_count], full_cycle_us, angle_mask);
+        arm_outputs();
+
+        // tooth to arm latency
+        const uint32_t latency = time_us_64() - ts_now;
+        gs->arm_latency_avg = (latency + gs->arm_latency_avg * 99) / 100;
+        if (latency > gs->arm_latency_max)
+            gs->arm_latency_max = latency;
+    }
+}
+
+void Decoder::next_crank_turn(GlobalState *gs)
+{
+    if (wheel.revs == 2)
+        return;
+
+    // the crank wheel origin alternates between 0 and 360 deg
+    cam_phase ^= 0x8000;
+    cam_revs_missed += 1;
+    if ((cam_revs_missed > 2) && (cam_confidence > 0))
+    {
+        // no cam edge for a full engine cycle, back to wasted spark / batch
+        cam_confidence = 0;
+        gs->cam_losses += 1;
+    }
+    gs->cam_sync = phased();
+}
+
+void Decoder::update_misfire(GlobalState *gs, uint32_t delta)
+{
+    // most teeth stay in the same segment: one multiply and a compare
+    const uint angle = (phased() ? cam_phase : 0) + wheel.tooth_angle[sync_count];
+    const uint seg = (angle * n_cylinders) >> 16;
+    if (seg == seg_current)
+        return;
+
+    // crank speed at the boundary, from the gap before this tooth: time of
+    // a full cycle at that speed, 1 us
+    const uint32_t period = ((uint64_t)delta << 16) / wheel.tooth_span[sync_count];
+    const uint32_t start = seg_period;
+    const uint ended = seg_current;
+    seg_current = seg;
+    seg_period = period;
+    seg_valid += 1;
+    if (seg_valid < 2)
+        return; // first segment is partial
+
+    // Speed lost over the segment that ended, 0.01 %. Pushed by its
+    // cylinder, the crank ends the segment as fast as it started it.
+    const int32_t slowdown = (int64_t)((int32_t)period - (int32_t)start) * 10000 / (int32_t)start;
+    if (seg_valid < 4)
+    {
+        // two full segments are needed before the first is judged
+        seg_slowdown[0] = seg_slowdown[1];
+        seg_slowdown[1] = slowdown;
+        seg_judged = ended;
+        return;
+    }
+
+    // The previous segment is judged against its neighbours, a steady
+    // acceleration cancels out
+    const int32_t excess = seg_slowdown[1] - (seg_slowdown[0] + slowdown) / 2;
+    const uint cyl = seg_judged;
+    seg_slowdown[0] = seg_slowdown[1];
+    seg_slowdown[1] = slowdown;
+    seg_judged = ended;
+
+    // rolling roughness over ~16 strokes of the cylinder, kept in range of
+    // the 16 bit field
+    const int32_t rough = MIN(MAX(excess, 0), UINT16_MAX);
+    gs->crank_roughness[cyl] += (rough - (int32_t)gs->crank_roughness[cyl]) / 16;
+    if (excess > (int32_t)misfire_threshold)
+        gs->misfires[cyl] += 1;
+}
+
+void Decoder::process_cam(GlobalState *gs, absolute_time_t ts_now)
+{
+    tooth_log.add(ts_now - ts_prev, sync_count, sync_step,
+                  TOOTH_LOG_CAM | ((sync_step == 3) ? TOOTH_LOG_SYNC : 0));
+
+    if ((sync_step < 3) || (wheel.revs == 2))
+        return; // crank position unknown, or phase already given by the wheel
+
+    // Compare the engine angle to the expected cam edge, in both phases
+    const uint angle = cam_phase + wheel.tooth_angle[sync_count];
+    const uint error = (angle - cam_angle + cam_window) & 0xFFFF;
+    const uint error_flipped = (angle + 0x8000 - cam_angle + cam_window) & 0xFFFF;
+    if (error < 2 * cam_window)
+    {
+        cam_revs_missed = 0;
+        if (cam_confidence < CAM_CONFIRM + 1)
+            cam_confidence += 1;
+    }
+    else if (error_flipped < 2 * cam_window)
+    {
+        cam_revs_missed = 0;
+        if (cam_confidence > 0)
+        {
+            // contradicts a known phase, only trust it if it happens again
+            cam_confidence -= 1;
+            gs->cam_noise += 1;
+        }
+        else
+        {
+            cam_phase ^= 0x8000;
+            cam_confidence = 1;
         }
-        delta_prev = delta;
-        ts_prev = ts_now;
-        next_timeout = ts_now + next_timeout_us;
+    }
+    else
+    {
+        gs->cam_noise += 1; // edge outside of the window
+    }
+    gs->cam_sync = phased();
+}
 
-        // update timing variables
-        full_cycle_us = delta_prev * N_PULSES;
-        fast_d = libdivide::divider<uint>(full_cycle_us);
+void Decoder::build_events(const uint *cur, uint n_cur)
+{
+    events_cycle_us = full_cycle_us;
+    const uint n = wheel.n_teeth;
+    const uint n_pos = (wheel.revs == 1) ? 2 * n : n;
 
-        // Update global state
-        gs->engine_speed = get_rpm();
-        return true;
+    // position of the tooth arming each output
+    uint pos[DECODER_MAX_OUTPUTS];
+    uint count[2 * WHEEL_MAX_TEETH + 1] = {0};
+    for (uint i = 0; i < DECODER_MAX_OUTPUTS; i++)
+    {
+        const uint32_t request = outputs[i].request.load(std::memory_order_relaxed);
+        pos[i] = n_pos; // disabled
+        if ((!outputs[i].trig && !outputs[i].coil) || !request || !full_cycle_us)
+            continue;
+
+        // 1/8 of the pulse as margin, the start angle moves earlier as the engine speeds up
+        // pulses are capped to 3/4 of their period, coils clamp their dwell further
+        const uint angle_mask = phased() ? 0xFFFF : (wheel.wheel_angle - 1);
+        const uint pw_angle = MIN(((uint64_t)output_pw(i, request) << 16) / full_cycle_us, (angle_mask + 1) * 3 / 4);
+        const uint start = ((request >> 16) - pw_angle - pw_angle / 8) & 0xFFFF;
+        const uint turn_angle = start & (wheel.wheel_angle - 1);
+        uint t = n;
+        while ((t > 0) && (wheel.tooth_angle[t - 1] > turn_angle))
+            t--;
+        // last tooth at or before the start, may be in the previous turn
+        pos[i] = (t + ((start >= wheel.wheel_angle) ? n : 0) + n_pos - 1) % n_pos;
+        count[pos[i]] += 1;
+
+        // moved back over the current tooth, it would skip this cycle
+        const uint old = event_pos[i] - 1;
+        const uint moved = (old + n_pos - pos[i]) % n_pos;
+        for (uint c = 0; (old < n_pos) && (moved < n_pos / 2) && (c < n_cur); c++)
+        {
+            const uint dist = (cur[c] + n_pos - pos[i]) % n_pos;
+            if ((dist > 0) && (dist <= moved))
+                arm_output(i);
+        }
     }
 
-    if ((get_absolute_time() > next_timeout) && (sync_step != 0))
+    // counting sort of the outputs by position
+    uint first = 0;
+    for (uint p = 0; p <= n_pos; p++)
     {
-        // Lost sync
-        sync_step = 0;
-        gs->engine_speed = 0;
+        event_first[p] = first;
+        first += count[p];
+        count[p] = event_first[p];
+    }
+    for (uint i = 0; i < DECODER_MAX_OUTPUTS; i++)
+    {
+        event_pos[i] = (pos[i] < n_pos) ? pos[i] + 1 : 0;
+        if (pos[i] < n_pos)
+            event_output[count[pos[i]]++] = i;
     }
+}
 
-    return false;
+uint Decoder::output_pw(uint i, uint32_t request)
+{
+    // coil charge time grows as the battery voltage drops
+    const uint pw = request & 0xFFFF;
+    return outputs[i].coil ? MIN(outputs[i].coil->dwell(state->battery_voltage), pw) : pw;
+}
+
+void Decoder::arm_output(uint i)
+{
+    const uint32_t request = outputs[i].request.load(std::memory_order_relaxed);
+    if (!request)
+        return;
+    if (outputs[i].coil)
+    {
+        const uint angle_mask = phased() ? 0xFFFF : (wheel.wheel_angle - 1);
+        const uint spark_period = (uint64_t)full_cycle_us * (angle_mask + 1) >> 16;
+        outputs[i].coil->update(ts_prev, end_time(request >> 16), output_pw(i, request), spark_period);
+    }
+    else if (!compute_target(outputs[i].trig, request >> 16, request & 0xFFFF, true))
+    {
+        return;
+    }
+    // followed on every tooth until it starts
+    outputs_busy |= 1 << i;
+}
+
+void Decoder::retarget_output(uint i)
+{
+    const uint32_t request = outputs[i].request.load(std::memory_order_relaxed);
+    if (outputs[i].coil || !request)
+    {
+        arm_output(i);
+        return;
+    }
+    const uint pw = request & 0xFFFF;
+    const int moved = outputs[i].trig->retarget(end_time(request >> 16) - pw, pw);
+    if (moved > 0)
+        state->output_retargets += 1;
+    else if (moved < 0)
+        state->output_late += 1;
+}
+
+void Decoder::arm_events(uint pos)
+{
+    for (uint k = event_first[pos]; k < event_first[pos + 1]; k++)
+        arm_output(event_output[k]);
+}
+
+void Decoder::arm_outputs()
+{
+    // positions of this tooth
+    uint cur[2];
+    uint n_cur = 1;
+    if (wheel.revs == 2)
+    {
+        cur[0] = sync_count;
+    }
+    else if (phased())
+    {
+        cur[0] = sync_count + (cam_phase ? wheel.n_teeth : 0);
+    }
+    else
+    {
+        // wasted spark / batch, both crank turns fire on every turn
+        cur[0] = sync_count;
+        cur[1] = sync_count + wheel.n_teeth;
+        n_cur = 2;
+    }
+
+    // rebuilt well before a speed change eats the 1/8 margin of the table
+    if (events_dirty.exchange(false, std::memory_order_acquire) ||
+        (full_cycle_us * 16 > events_cycle_us * 17) || (full_cycle_us * 16 < events_cycle_us * 15))
+        build_events(cur, n_cur);
+
+    // pending pulses and coils retimed from the latest tooth until they start
+    for (uint busy = outputs_busy; busy; busy &= busy - 1)
+    {
+        const uint i = __builtin_ctz(busy);
+        if (outputs[i].coil ? outputs[i].coil->busy() : outputs[i].trig->pending())
+            retarget_output(i);
+        else
+            outputs_busy &= ~(1U << i);
+    }
+
+    // only the outputs armed on this tooth
+    for (uint c = 0; c < n_cur; c++)
+        arm_events(cur[c]);
 }
 
-bool Decoder::compute_target(Trigger *trig, uint end_deg, uint pw)
+int Decoder::angle_to_us(int angle)
 {
-    const uint pw_deg = pw * 0x10000 / fast_d;
-    const int deg_until_end = (end_deg - pulse_angles[sync_count]) & 0xFFFF;
-    const int deg_until_start = deg_until_end - pw_deg;
-    const int us_until_start = deg_until_start * full_cycle_us / 0x10000;
+    // The cycle time changes by cycle_trend every tooth. Over n teeth the mean
+    // cycle time is full_cycle_us + cycle_trend * (n + 1) / 2.
+    const int64_t n_teeth_q8 = (int64_t)angle * wheel.cycle_mult[wheel.hunt_tooth] >> 16;
+    const int64_t cycle_us = full_cycle_us + ((cycle_trend * (n_teeth_q8 + 256)) >> 14);
+    return (angle * cycle_us) >> 16;
+}
 
-    const absolute_time_t target = ts_prev + us_until_start;
-    const absolute_time_t now = get_absolute_time();
+absolute_time_t Decoder::end_time(uint end_deg)
+{
+    // without cam phase, fire on every crank turn (wasted spark / batch)
+    const uint angle_mask = phased() ? 0xFFFF : (wheel.wheel_angle - 1);
+    const uint tooth_angle = (phased() ? cam_phase : 0) + wheel.tooth_angle[sync_count];
+    const int deg_until_end = (end_deg - tooth_angle) & angle_mask;
+    return ts_prev + angle_to_us(deg_until_end);
+}
 
-    if (absolute_time_diff_us(now, target) < 100) // 100 us = 6 deg at 10000 rpm
+bool Decoder::compute_target(Trigger *trig, uint end_deg, uint pw, bool scheduled)
+{
+    const absolute_time_t target = end_time(end_deg) - pw;
+    const int us_until_start = target - ts_prev;
+
+    // arm from the last tooth before the start, later teeth would not improve it
+    const int us_until_next_tooth = (uint64_t)full_cycle_us * wheel.tooth_span[wheel.next(sync_count)] >> 16;
+    if (scheduled || (us_until_start < us_until_next_tooth))
     {
-        return trig->update(target, pw);
+        if (trig->update(target, pw))
+        {
+            tooth_log.mark_output();
+            return true;
+        }
     }
     return false;
 }
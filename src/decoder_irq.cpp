@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/sem.h"
+#include "hardware/clocks.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/timer.h"
+
+#include "decoder.h"
+
+#include "tooth_capture.pio.h"
+
+// Hardware side of the decoder: tooth capture IRQs and the stall alarm.
+// The sync logic in decoder.cpp only sees timestamps and builds off-target.
+
+// The GPIO and PIO IRQs share the default priority and never preempt each other,
+// the ring keeps a single producer.
+static Decoder *capture_decoder;
+static uint cam_gpio = -1;
+
+// Interrupt-driven processing, the tooth IRQ is the ring consumer
+static Decoder *irq_decoder = nullptr;
+
+// Stall detection, the hardware alarm is pushed back on every tooth
+static Decoder *timeout_decoder;
+static void __not_in_flash_func(timeout_callback)(uint)
+{
+    // teeth still in the ring: the engine turns, the main loop is late. The
+    // alarm is armed again when they are drained, update() catches a stop.
+    if (timeout_decoder->ring.size() > 0)
+        return;
+    timeout_decoder->stall(timeout_decoder->state);
+}
+
+void __not_in_flash_func(new_ts_callback)(uint gpio, uint32_t)
+{
+    const absolute_time_t new_ts = get_absolute_time();
+    capture_decoder->push_tooth(new_ts, gpio == cam_gpio);
+
+    if (irq_decoder)
+        irq_decoder->drain(irq_decoder->state);
+}
+
+// PIO capture, pio0 is used by can2040
+static const PIO capture_pio = pio1;
+static uint capture_sm;
+static uint32_t capture_prev_count;
+static uint32_t capture_ticks; // system clocks not yet converted to us
+static uint32_t capture_ticks_per_us;
+static absolute_time_t capture_ts;
+static bool capture_started = false;
+
+static void __not_in_flash_func(capture_irq_handler)()
+{
+    while (!pio_sm_is_rx_fifo_empty(capture_pio, capture_sm))
+    {
+        const uint32_t count = pio_sm_get(capture_pio, capture_sm);
+        const uint32_t period = 2 * (capture_prev_count - count) + TOOTH_CAPTURE_EDGE_CYCLES;
+        capture_prev_count = count;
+
+        if (!capture_started || (get_absolute_time() - capture_ts > 1'000'000))
+        {
+            // first tooth or engine stopped for more than 1s, (re)align on the system timer
+            capture_ts = get_absolute_time();
+            capture_ticks = 0;
+            capture_started = true;
+        }
+        else
+        {
+            // timestamp is rebuilt from the periods, IRQ latency does not matter
+            capture_ticks += period;
+            const uint32_t us = capture_ticks / capture_ticks_per_us;
+            capture_ticks -= us * capture_ticks_per_us;
+            capture_ts += us;
+        }
+        capture_decoder->push_tooth(capture_ts, 0);
+    }
+
+    if (irq_decoder)
+        irq_decoder->drain(irq_decoder->state);
+}
+
+void Decoder::enable(GlobalState *gs, uint pin, bool pio_capture)
+{
+    state = gs;
+    timeout_decoder = this;
+    irq_decoder = nullptr; // drained by update() until enable_irq_processing()
+    timeout_alarm_num = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(timeout_alarm_num, timeout_callback);
+
+    if (wheel.n_teeth == 0)
+        wheel.missing_tooth(24, 1, 2);
+
+    capture_decoder = this;
+    if (pio_capture)
+    {
+        // 1 us timer and system clock both come from XOSC, they do not drift
+        capture_ticks_per_us = clock_get_hz(clk_sys) / 1'000'000;
+        capture_sm = pio_claim_unused_sm(capture_pio, true);
+        const uint offset = pio_add_program(capture_pio, &tooth_capture_program);
+        tooth_capture_program_init(capture_pio, capture_sm, offset, pin);
+
+        pio_set_irq0_source_enabled(capture_pio, (pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + capture_sm), true);
+        irq_set_exclusive_handler(PIO1_IRQ_0, capture_irq_handler);
+        irq_set_enabled(PIO1_IRQ_0, true);
+    }
+    else
+    {
+        gpio_set_irq_enabled_with_callback(pin, GPIO_IRQ_EDGE_RISE, true, new_ts_callback);
+    }
+}
+
+void Decoder::enable_cam(uint pin, uint angle)
+{
+    cam_angle = angle & 0xFFFF;
+    cam_gpio = pin;
+    gpio_set_irq_enabled_with_callback(pin, GPIO_IRQ_EDGE_RISE, true, new_ts_callback);
+}
+
+void Decoder::enable_irq_processing()
+{
+    // GPIO and PIO IRQs keep the same priority, they must not preempt each other
+    irq_decoder = this;
+    irq_processing = true;
+    irq_set_priority(IO_IRQ_BANK0, PICO_HIGHEST_IRQ_PRIORITY);
+    irq_set_priority(PIO1_IRQ_0, PICO_HIGHEST_IRQ_PRIORITY);
+}
+
+void Decoder::set_timeout_alarm(absolute_time_t t)
+{
+    // not enabled, e.g. the update() benchmark: update() still sees a stall
+    if (timeout_alarm_num >= 0)
+        hardware_alarm_set_target(timeout_alarm_num, t);
+}
@@ -12,13 +12,23 @@
 #include "tusb.h"
 
 #include "avr.h"
+#include "axis.h"
 #include "decoder.h"
 #include "flash.h"
 #include "global_state.h"
 #include "linear_interp.h"
+#include "pio_output.h"
 #include "crc32.h"
+#include "stop_position.h"
+
+#ifdef DECODER_BENCH
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#include "decoder_bench.h"
+#endif
 
 static GlobalState gs;
+static Decoder dec;
 
 static uint8_t *page1_offset = (uint8_t *)XIP_BASE + PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE;
 
@@ -33,8 +43,17 @@ static struct
 
     int16_t ve_x_axis[16];
     int16_t ve_y_axis[16];
+
+    uint16_t wheel_angles[WHEEL_MAX_TEETH]; // 1/0x10000 of a wheel turn
+    uint8_t wheel_n_teeth;
+    uint8_t wheel_revs; // 1=crank, 2=cam
+    uint8_t cam_pin;    // 0xFF=no cam input
+    uint16_t cam_angle; // engine angle of the cam edge, 0x10000=720 deg
 } page1;
 
+// page1 axes, loaded with page1: engine speed in rpm, MAP in 0.1 kPa
+static Axis<16> ve_x_axis, ve_y_axis;
+
 void transmit_response(const uint8_t *buffer, size_t n)
 {
     // compute crc on payload (exclude size)
@@ -72,6 +91,9 @@ void core1_entry()
     static uint8_t buffer[4096];
     static uint16_t buffer_size = 0;
 
+    // allow core0 to write the flash
+    flash_safe_execute_core_init();
+
     while (true)
     {
         buffer_size += tud_cdc_read(buffer + buffer_size, sizeof(buffer) - buffer_size);
@@ -124,6 +146,78 @@ void core1_entry()
                     transmit_response(res, sizeof(res));
                     break;
                 }
+                case 'r':
+                {
+                    // r, can id, table, offset (BE), size (BE)
+                    const uint8_t table = buffer[4];
+                    const uint16_t offset = buffer[6] + 0x100 * buffer[5];
+                    const uint16_t size = buffer[8] + 0x100 * buffer[7];
+                    if ((table == 0xF0) || (table == 0xF2))
+                    {
+                        // 0xF0 tooth log: 4 bytes per crank tooth, period in us
+                        // 0xF2 composite log: 7 bytes per event, flags, tooth, sync step, period in us
+                        // Read while the engine runs, no need to stop the logger
+                        static ToothLogEntry entries[TOOTH_LOG_SIZE];
+                        static uint8_t res[1 + TOOTH_LOG_SIZE * 7];
+                        const bool composite = (table == 0xF2);
+                        const uint n = dec.tooth_log.read(entries, 0, TOOTH_LOG_SIZE);
+                        uint len = 0;
+                        res[len++] = 0; // OK flag
+                        for (uint i = 0; i < n; i++)
+                        {
+                            const ToothLogEntry &e = entries[i];
+                            if (composite)
+                            {
+                                res[len++] = e.flags;
+                                res[len++] = e.tooth;
+                                res[len++] = e.sync_step;
+                            }
+                            else if (e.flags & TOOTH_LOG_CAM)
+                            {
+                                continue;
+                            }
+                            res[len++] = e.period >> 24;
+                            res[len++] = e.period >> 16;
+                            res[len++] = e.period >> 8;
+                            res[len++] = e.period >> 0;
+                        }
+                        // only send the requested window
+                        const uint first = MIN(1 + offset, len);
+                        const uint count = MIN((uint)size, len - first);
+                        memmove(res + 1, res + first, count);
+                        transmit_response(res, 1 + count);
+                    }
+                    else if (table == 0xF3)
+                    {
+                        // 0xF3 output timing: per output, histogram then max late,
+                        // late, missed, rejected, 4 bytes each
+                        static uint8_t res[1 + DECODER_MAX_OUTPUTS * (OUTPUT_STATS_BUCKETS + 4) * 4];
+                        uint len = 0;
+                        res[len++] = 0; // OK flag
+                        for (uint i = 0; i < DECODER_MAX_OUTPUTS; i++)
+                        {
+                            const OutputStats &o = gs.output_stats[i];
+                            uint32_t values[OUTPUT_STATS_BUCKETS + 4];
+                            memcpy(values, o.hist, sizeof(o.hist));
+                            values[OUTPUT_STATS_BUCKETS + 0] = o.max_late;
+                            values[OUTPUT_STATS_BUCKETS + 1] = o.late;
+                            values[OUTPUT_STATS_BUCKETS + 2] = o.missed;
+                            values[OUTPUT_STATS_BUCKETS + 3] = o.rejected;
+                            for (uint32_t v : values)
+                            {
+                                res[len++] = v >> 24;
+                                res[len++] = v >> 16;
+                                res[len++] = v >> 8;
+                                res[len++] = v >> 0;
+                            }
+                        }
+                        const uint first = MIN(1 + offset, len);
+                        const uint count = MIN((uint)size, len - first);
+                        memmove(res + 1, res + first, count);
+                        transmit_response(res, 1 + count);
+                    }
+                    break;
+                }
                 }
                 buffer_size = 0;
             }
@@ -166,8 +260,6 @@ volatile uint16_t test;
 
 int main()
 {
-    Decoder dec;
-
     stdio_init_all();
 
     // Watchdog example code
@@ -177,6 +269,38 @@ int main()
         // Whatever action you may take if a watchdog caused a reboot
     }
 
+#ifdef DECODER_BENCH
+    {
+        // Decoder::update() cost per tooth, SysTick counts processor clocks
+        systick_hw->rvr = 0xFFFFFF;
+        systick_hw->cvr = 0;
+        systick_hw->csr = 0x5;
+        static Decoder bench_dec;
+        static GlobalState bench_gs;
+        const DecoderBenchResult r = decoder_bench(
+            bench_dec, bench_gs, 10000, []() { return 0xFFFFFF - systick_hw->cvr; }, 0xFFFFFF);
+        sleep_ms(2000); // USB enumeration
+        printf("update: %lu cycles per tooth, libdivide divider %lu cycles, timer read %lu cycles\n",
+               r.update - r.empty, r.libdivide - r.empty, r.empty);
+        const uint32_t log_cycles_64 = r.log_64 - r.empty;
+        printf("tooth log: %lu.%02lu cycles, %lu ns per event\n", log_cycles_64 / 64, log_cycles_64 % 64 * 100 / 64,
+               (uint32_t)((uint64_t)log_cycles_64 * 1'000'000'000 / 64 / clock_get_hz(clk_sys)));
+        printf("angle clock per 16 queries: now_angle %lu cycles, divide from the last tooth %lu cycles; "
+               "angle_to_time %lu cycles, from the last tooth %lu cycles\n",
+               r.now_angle_16 - r.empty, r.angle_divide_16 - r.empty, r.to_time_16 - r.empty, r.time_tooth_16 - r.empty);
+    }
+#endif
+
+#ifdef PIO_OUTPUT_LOOPBACK
+    // Output edge self test, PIO_OUTPUT_LOOPBACK is a free pin. Takes 1 s,
+    // before the watchdog is running
+    const int loopback_sm = pio_output_claim(PIO_OUTPUT_LOOPBACK);
+    gs.output_jitter = (loopback_sm >= 0) ? pio_output_loopback(loopback_sm, PIO_OUTPUT_LOOPBACK, 1000, 1000, 100) : UINT32_MAX;
+#endif
+
+    // Flash sector erase, if due, before the watchdog runs
+    stop_position_init();
+
     // Enable the watchdog, requiring the watchdog to be updated every 100ms or the chip will reboot
     watchdog_enable(100, true);
 
@@ -196,10 +320,22 @@ int main()
 
     // Read flash
     memcpy(&page1, page1_offset, sizeof(page1));
+    ve_x_axis.load(page1.ve_x_axis);
+    ve_y_axis.load(page1.ve_y_axis);
 
     avr_init(); // SPI & UPDI
 
-    dec.enable(0);
+    // Trigger wheel from config, falls back to 24-1 on the cam
+    dec.wheel.load(page1.wheel_angles, page1.wheel_n_teeth, page1.wheel_revs);
+    dec.enable(&gs, 0);
+    dec.enable_irq_processing();
+    if (page1.cam_pin < NUM_BANK0_GPIOS)
+        dec.enable_cam(page1.cam_pin, page1.cam_angle);
+
+    // Restart from where the engine stopped
+    uint stop_tooth;
+    if (stop_position_load(dec.wheel.n_teeth, &stop_tooth))
+        dec.fast_start(stop_tooth);
 
     multicore_launch_core1(core1_entry);
 
@@ -210,6 +346,8 @@ int main()
     {
         watchdog_update();
         dec.update(&gs);
+        if (dec.check_stop(time_us_64()))
+            stop_position_save(dec.wheel.n_teeth, dec.stop_tooth);
         // avr_update_updi();
         avr_update_adc(&gs);
 
@@ -221,6 +359,16 @@ int main()
             gs.pico_temperature = (int16_t)(temperature * 10);
             hw_set_bits(&adc_hw->cs, ADC_CS_START_ONCE_BITS);
         }
+
+        {
+            // VE, AFR and advance share the axes, bins and alphas found once
+            static const uint16_t *const tables[] = {page1.ve_table, page1.afr_table, page1.adv_table};
+            uint16_t values[3];
+            bilinear_interp(ve_x_axis, ve_y_axis, tables, values, (int16_t)gs.engine_speed, gs.manifold_pressure);
+            gs.ve = values[0];
+            gs.afr_target = values[1];
+            gs.advance = values[2];
+        }
         {
             // Print ADC values
             // for (int i = 0; i < 7; i++)
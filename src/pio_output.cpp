@@ -0,0 +1,124 @@
+#include "pio_output.h"
+
+#include "hardware/clocks.h"
+#include "hardware/pio.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+#include "pulse_out.pio.h"
+#include "tooth_capture.pio.h"
+
+// pio0 is used by can2040, pio1 by the tooth capture
+#if NUM_PIOS > 2
+static const PIO output_pio = pio2;
+#else
+static const PIO output_pio = pio1;
+#endif
+static int output_offset = -1;
+static uint32_t cycles_per_us;
+
+int pio_output_claim(uint pin)
+{
+    if (output_offset < 0)
+    {
+        if (!pio_can_add_program(output_pio, &pulse_out_program))
+            return -1;
+        output_offset = pio_add_program(output_pio, &pulse_out_program);
+        cycles_per_us = clock_get_hz(clk_sys) / 1'000'000;
+    }
+    const int sm = pio_claim_unused_sm(output_pio, false);
+    if (sm < 0)
+        return -1;
+    pulse_out_program_init(output_pio, sm, output_offset, pin);
+    return sm;
+}
+
+void __not_in_flash_func(pio_output_fire)(uint sm, absolute_time_t start, uint pw, absolute_time_t after)
+{
+    // wait for the next timer tick, the delay is then exact to a few clocks.
+    // An IRQ between the tick and the puts would make the delay late.
+    const uint32_t status = save_and_disable_interrupts();
+    const uint32_t tick = timer_hw->timerawl;
+    while (timer_hw->timerawl == tick)
+        tight_loop_contents();
+    const int32_t us_until_after = (uint32_t)after - (tick + 1);
+    const uint32_t from = (us_until_after > 0) ? (uint32_t)after : tick + 1;
+    const int32_t us_until_start = (uint32_t)start - from;
+
+    // late pulses start right away, with their full width
+    const uint32_t delay = (us_until_start > 0) ? us_until_start * cycles_per_us - PULSE_OUT_START_CYCLES : 0;
+    pio_sm_put(output_pio, sm, delay);
+    pio_sm_put(output_pio, sm, pw * cycles_per_us - PULSE_OUT_HIGH_CYCLES);
+    restore_interrupts(status);
+}
+
+void pio_output_stop(uint sm)
+{
+    pio_sm_set_enabled(output_pio, sm, false);
+    pio_sm_clear_fifos(output_pio, sm);
+    pio_sm_restart(output_pio, sm);
+    pio_sm_exec(output_pio, sm, pio_encode_nop() | pio_encode_sideset_opt(1, 0));
+    pio_sm_exec(output_pio, sm, pio_encode_jmp(output_offset));
+    pio_sm_set_enabled(output_pio, sm, true);
+}
+
+struct LoopbackPulse
+{
+    uint sm;
+    absolute_time_t start;
+    uint pw;
+};
+
+static int64_t loopback_callback(alarm_id_t, void *data)
+{
+    const LoopbackPulse *p = (const LoopbackPulse *)data;
+    pio_output_fire(p->sm, p->start, p->pw);
+    return 0;
+}
+
+uint32_t pio_output_loopback(uint sm, uint pin, uint n, uint period, uint pw)
+{
+    // the capture input reads the pad, no wiring needed
+    if (!pio_can_add_program(output_pio, &tooth_capture_program))
+        return UINT32_MAX;
+    const int cap_sm = pio_claim_unused_sm(output_pio, false);
+    if (cap_sm < 0)
+        return UINT32_MAX;
+    const uint cap_offset = pio_add_program(output_pio, &tooth_capture_program);
+    // not tooth_capture_program_init(), the pin must stay an output
+    pio_sm_config c = tooth_capture_program_get_default_config(cap_offset);
+    sm_config_set_jmp_pin(&c, pin);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);
+    pio_sm_init(output_pio, cap_sm, cap_offset + tooth_capture_offset_high, &c);
+    pio_sm_set_enabled(output_pio, cap_sm, true);
+
+    uint32_t err_max = 0;
+    uint32_t count_prev = 0;
+    LoopbackPulse p = {sm, get_absolute_time() + 1000, pw};
+    for (uint i = 0; i <= n; i++)
+    {
+        add_alarm_at(p.start - PIO_OUTPUT_LEAD_US, loopback_callback, &p, true);
+        sleep_until(p.start + pw + 10);
+        if (pio_sm_is_rx_fifo_empty(output_pio, cap_sm))
+        {
+            err_max = UINT32_MAX; // edge not seen
+            break;
+        }
+        const uint32_t count = pio_sm_get(output_pio, cap_sm);
+        if (i > 0)
+        {
+            // the capture counter runs at half the system clock
+            const int32_t cycles = 2 * (count_prev - count) + TOOTH_CAPTURE_EDGE_CYCLES;
+            const int32_t err = cycles - (int32_t)(period * cycles_per_us);
+            const uint32_t err_ns = (uint64_t)(err < 0 ? -err : err) * 1000 / cycles_per_us;
+            err_max = MAX(err_max, err_ns);
+        }
+        count_prev = count;
+        p.start += period;
+    }
+
+    pio_sm_set_enabled(output_pio, cap_sm, false);
+    pio_remove_program(output_pio, &tooth_capture_program, cap_offset);
+    pio_sm_unclaim(output_pio, cap_sm);
+    return err_max;
+}
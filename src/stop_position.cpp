@@ -0,0 +1,88 @@
+#include <cstring>
+
+#include "stop_position.h"
+
+#include "flash.h"
+
+// One record per flash page, the sector is erased at the next boot once all
+// pages are used
+static const uint32_t STOP_OFFSET = PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE * 3;
+static const uint32_t STOP_RECORDS = FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE;
+static const uint32_t STOP_MAGIC = 0x53544F50; // "STOP"
+
+struct StopRecord
+{
+    uint32_t magic;
+    uint16_t n_teeth;
+    uint16_t tooth;
+    uint32_t check; // ~(n_teeth, tooth)
+};
+
+static const StopRecord *stop_record(uint i)
+{
+    return (const StopRecord *)(XIP_BASE + STOP_OFFSET + i * FLASH_PAGE_SIZE);
+}
+
+// Index of the first erased page
+static uint stop_next_free()
+{
+    uint i = 0;
+    while ((i < STOP_RECORDS) && (stop_record(i)->magic != 0xFFFFFFFF))
+        i++;
+    return i;
+}
+
+void stop_position_init()
+{
+    if (stop_next_free() < STOP_RECORDS)
+        return;
+    // the last record moves to the first page of the erased sector
+    const StopRecord last = *stop_record(STOP_RECORDS - 1);
+    safe_flash_range_erase(STOP_OFFSET);
+    if (last.magic == STOP_MAGIC)
+    {
+        static uint8_t page[FLASH_PAGE_SIZE];
+        memset(page, 0xFF, sizeof(page));
+        memcpy(page, &last, sizeof(last));
+        safe_flash_range_program(STOP_OFFSET, page);
+    }
+}
+
+bool stop_position_load(uint n_teeth, uint *tooth)
+{
+    const uint next = stop_next_free();
+    if (next == 0)
+        return false;
+
+    const StopRecord *r = stop_record(next - 1);
+    if ((r->magic != STOP_MAGIC) ||
+        (r->check != ~((uint32_t)r->n_teeth << 16 | r->tooth)) ||
+        (r->n_teeth != n_teeth) || (r->tooth >= n_teeth))
+        return false;
+
+    *tooth = r->tooth;
+    return true;
+}
+
+bool stop_position_save(uint n_teeth, uint tooth)
+{
+    const uint next = stop_next_free();
+    static uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+    StopRecord *r = (StopRecord *)page;
+    if (next >= STOP_RECORDS)
+    {
+        // no erase with the watchdog running, programming can still clear
+        // the magic of the last record: it no longer matches this stop
+        r->magic = 0;
+        safe_flash_range_program(STOP_OFFSET + (STOP_RECORDS - 1) * FLASH_PAGE_SIZE, page);
+        return false;
+    }
+
+    r->magic = STOP_MAGIC;
+    r->n_teeth = n_teeth;
+    r->tooth = tooth;
+    r->check = ~((uint32_t)n_teeth << 16 | tooth);
+    safe_flash_range_program(STOP_OFFSET + next * FLASH_PAGE_SIZE, page);
+    return true;
+}
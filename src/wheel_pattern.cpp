@@ -0,0 +1,104 @@
+#include "wheel_pattern.h"
+
+bool WheelPattern::load(const uint16_t *angles, uint n, uint wheel_revs)
+{
+    n_teeth = 0; // invalid until fully loaded
+
+    if ((n < 3) || (n > WHEEL_MAX_TEETH) || (wheel_revs < 1) || (wheel_revs > 2))
+        return false;
+    for (uint i = 1; i < n; i++)
+    {
+        if (angles[i] <= angles[i - 1])
+            return false;
+    }
+
+    revs = wheel_revs;
+    wheel_angle = 0x8000 * revs;
+
+    uint32_t ratio[WHEEL_MAX_TEETH];
+    for (uint i = 0; i < n; i++)
+    {
+        tooth_angle[i] = angles[i] * revs / 2;
+    }
+    for (uint i = 0; i < n; i++)
+    {
+        const uint prev = (i + n - 1) % n;
+        tooth_span[i] = (tooth_angle[i] - tooth_angle[prev]) & (wheel_angle - 1);
+        if (tooth_span[i] == 0)
+            return false;
+        cycle_mult[i] = (0x10000U << 8) / tooth_span[i];
+    }
+    for (uint i = 0; i < n; i++)
+    {
+        const uint prev = (i + n - 1) % n;
+        ratio[i] = (tooth_span[i] * 256 + tooth_span[prev] / 2) / tooth_span[prev];
+        timeout_mult[i] = ratio[i] * 5 / 4;
+        crank_timeout_mult[i] = ratio[i] * 2;
+    }
+
+    // Sort the ratios and group the close ones (within 12.5%) into classes
+    uint32_t sorted[WHEEL_MAX_TEETH];
+    for (uint i = 0; i < n; i++)
+    {
+        uint j = i;
+        for (; (j > 0) && (sorted[j - 1] > ratio[i]); j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = ratio[i];
+    }
+    uint32_t class_lo[WHEEL_MAX_TEETH], class_hi[WHEEL_MAX_TEETH];
+    uint n_classes = 0;
+    for (uint i = 0; i < n; i++)
+    {
+        if ((n_classes == 0) || (sorted[i] > class_lo[n_classes - 1] * 9 / 8))
+        {
+            class_lo[n_classes] = sorted[i];
+            n_classes += 1;
+        }
+        class_hi[n_classes - 1] = sorted[i];
+    }
+    if (n_classes < 2)
+        return false; // evenly spaced, nothing to sync on
+
+    // Each tooth accepts the ratios up to halfway to the neighbouring classes
+    uint key_count = 0;
+    for (uint i = 0; i < n; i++)
+    {
+        uint c = 0;
+        while (ratio[i] > class_hi[c])
+            c++;
+        ratio_min[i] = (c == 0) ? 0 : (class_hi[c - 1] + class_lo[c]) / 2;
+        ratio_max[i] = (c == n_classes - 1) ? UINT32_MAX : (class_hi[c] + class_lo[c + 1]) / 2;
+        if (c == n_classes - 1)
+        {
+            key_tooth = i;
+            key_count += 1;
+        }
+    }
+    if (key_count != 1)
+        return false; // sync gap is not unique
+
+    hunt_tooth = (key_tooth + 1) % n;
+    n_teeth = n;
+    return true;
+}
+
+bool WheelPattern::missing_tooth(uint n_pulses, uint n_missing, uint wheel_revs)
+{
+    uint16_t angles[WHEEL_MAX_TEETH];
+    if ((n_pulses > WHEEL_MAX_TEETH) || (n_missing >= n_pulses))
+        return false;
+    for (uint i = 0; i < n_pulses - n_missing; i++)
+        angles[i] = i * 0x10000 / n_pulses;
+    return load(angles, n_pulses - n_missing, wheel_revs);
+}
+
+bool WheelPattern::plus_one(uint n_pulses, uint wheel_revs)
+{
+    uint16_t angles[WHEEL_MAX_TEETH];
+    if (n_pulses + 1 > WHEEL_MAX_TEETH)
+        return false;
+    for (uint i = 0; i < n_pulses; i++)
+        angles[i] = i * 0x10000 / n_pulses;
+    angles[n_pulses] = (2 * n_pulses - 1) * 0x8000 / n_pulses; // halfway in the last gap
+    return load(angles, n_pulses + 1, wheel_revs);
+}
@@ -0,0 +1,74 @@
+// Table lookups with the interpolation division against the Axis
+// reciprocals, 16 point axes and a 16x16 table, values moving slowly like
+// engine speed and load. ns per linear and bilinear lookup.
+//
+// bench_axis [max ns per bilinear Axis lookup]
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "axis.h"
+
+static const int16_t x_points[16] = {500, 800, 1100, 1400, 1700, 2000, 2500, 3000,
+                                     3500, 4000, 4500, 5000, 5500, 6000, 6500, 7000};
+static const int16_t y_points[16] = {200, 250, 300, 350, 400, 450, 500, 550,
+                                     600, 650, 700, 750, 800, 900, 1000, 1050};
+
+int main(int argc, char **argv)
+{
+    const double max_ns = (argc > 1) ? atof(argv[1]) : 1e9;
+    uint16_t table[16 * 16];
+    for (uint i = 0; i < 16 * 16; i++)
+        table[i] = (uint16_t)(i * 251);
+
+    const size_t n = 1'000'000;
+    std::vector<int16_t> xs(n), ys(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        xs[i] = (int16_t)(3750 + 3200 * std::sin(i * 2e-5));
+        ys[i] = (int16_t)(625 + 420 * std::sin(i * 3e-5 + 1));
+    }
+
+    Axis<16> ax, ay;
+    ax.load(x_points);
+    ay.load(y_points);
+    size_t hx = 0, hy = 0;
+
+    const auto now = []() { return std::chrono::steady_clock::now(); };
+    const auto ns = [&](auto t0) { return std::chrono::duration<double, std::nano>(now() - t0).count() / n; };
+    volatile uint16_t sink;
+    double lin_div = 1e9, lin_axis = 1e9, bi_div = 1e9, bi_axis = 1e9;
+    uint mismatches = 0;
+    for (int pass = 0; pass < 5; pass++)
+    {
+        auto t0 = now();
+        for (size_t i = 0; i < n; i++)
+            sink = linear_interp(x_points, 16, table, xs[i], &hx);
+        lin_div = std::min(lin_div, ns(t0));
+
+        t0 = now();
+        for (size_t i = 0; i < n; i++)
+            sink = linear_interp(ax, table, xs[i]);
+        lin_axis = std::min(lin_axis, ns(t0));
+
+        t0 = now();
+        for (size_t i = 0; i < n; i++)
+            sink = bilinear_interp(x_points, 16, y_points, 16, table, xs[i], ys[i], &hx, &hy);
+        bi_div = std::min(bi_div, ns(t0));
+
+        t0 = now();
+        for (size_t i = 0; i < n; i++)
+            sink = bilinear_interp(ax, ay, table, xs[i], ys[i]);
+        bi_axis = std::min(bi_axis, ns(t0));
+    }
+    for (size_t i = 0; i < n; i++)
+        mismatches += (bilinear_interp(ax, ay, table, xs[i], ys[i]) !=
+                       bilinear_interp(x_points, 16, y_points, 16, table, xs[i], ys[i]));
+    (void)sink;
+    printf("linear: %.2f ns per lookup with the division, %.2f ns with the Axis\n", lin_div, lin_axis);
+    printf("bilinear: %.2f ns per lookup with the division, %.2f ns with the Axis, %u mismatches\n",
+           bi_div, bi_axis, mismatches);
+    return (mismatches == 0) && (bi_axis < max_ns) ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+// Axis bin search with the last-bin hint against the binary search, on
+// RPM/MAP sweeps sampled at a 10 kHz main loop: pulls through the gears,
+// shifts, overrun and idle, MAP following the throttle with a lag and both
+// with sensor noise. Hit rate of the hint (same bin, neighbour, full search)
+// and ns per lookup.
+//
+// bench_find_bin [max ns per hinted lookup]
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "linear_interp.h"
+
+static const int16_t rpm_axis[16] = {500, 800, 1100, 1400, 1700, 2000, 2500, 3000,
+                                     3500, 4000, 4500, 5000, 5500, 6000, 6500, 7000}; // 1 rpm
+static const int16_t map_axis[16] = {200, 250, 300, 350, 400, 450, 500, 550,
+                                     600, 650, 700, 750, 800, 900, 1000, 1050}; // 0.1 kPa
+
+struct Phase
+{
+    double seconds;
+    double rpm_to; // linear from the previous phase
+    double map;    // throttle target, 0.1 kPa
+};
+
+// one lap, repeated
+static const Phase lap[] = {
+    {2.0, 850, 350},  // idle
+    {3.0, 6000, 980}, // first gear
+    {0.3, 3600, 250}, // shift
+    {4.0, 6200, 990}, // second gear
+    {0.3, 4200, 250}, // shift
+    {6.0, 5200, 650}, // cruise up
+    {5.0, 1200, 220}, // overrun
+    {0.5, 850, 350},  // clutch in
+};
+
+int main(int argc, char **argv)
+{
+    const double max_ns = (argc > 1) ? atof(argv[1]) : 1e9;
+    const double dt = 100e-6; // s, 10 kHz
+    const double seconds = 60;
+    std::mt19937 rng(1);
+    std::normal_distribution<double> noise(0, 1);
+
+    std::vector<int16_t> rpm, map;
+    double r = 850, m = 350, phase_t = 0, rpm_from = r;
+    uint p = 0;
+    for (double t = 0; t < seconds; t += dt)
+    {
+        const Phase &ph = lap[p];
+        r = rpm_from + (ph.rpm_to - rpm_from) * std::min(phase_t / ph.seconds, 1.0);
+        m += (ph.map - m) * dt / 0.05; // 50 ms manifold lag
+        rpm.push_back((int16_t)std::lround(r + 10 * noise(rng)));
+        map.push_back((int16_t)std::lround(m + 3 * noise(rng)));
+        phase_t += dt;
+        if (phase_t >= ph.seconds)
+        {
+            rpm_from = ph.rpm_to;
+            phase_t = 0;
+            p = (p + 1) % (sizeof(lap) / sizeof(lap[0]));
+        }
+    }
+    const size_t n = rpm.size();
+
+    // hit rate, with the same clamping as the lookups
+    uint same = 0, neighbour = 0, search = 0, mismatches = 0;
+    size_t hints[2] = {0, 0};
+    const int16_t *axes[2] = {rpm_axis, map_axis};
+    for (size_t i = 0; i < n; i++)
+    {
+        const int16_t v[2] = {rpm[i], map[i]};
+        for (int a = 0; a < 2; a++)
+        {
+            const int16_t x = MIN(MAX(v[a], axes[a][0]), axes[a][15] - 1);
+            const size_t before = hints[a];
+            const size_t bin = find_bin(axes[a], 16, x, &hints[a]);
+            if (bin == before)
+                same += 1;
+            else if ((bin == before + 1) || (bin + 1 == before))
+                neighbour += 1;
+            else
+                search += 1;
+            mismatches += (bin != find_bin(axes[a], 16, x));
+        }
+    }
+    // any value, any hint
+    for (uint i = 0; i < 1'000'000; i++)
+    {
+        const int16_t x = rpm_axis[0] + (int16_t)(rng() % (rpm_axis[15] - rpm_axis[0]));
+        size_t hint = rng() % 15;
+        mismatches += (find_bin(rpm_axis, 16, x, &hint) != find_bin(rpm_axis, 16, x));
+    }
+    const double lookups = 2.0 * n;
+    printf("%zu samples per axis: %.1f %% same bin, %.1f %% neighbour, %.1f %% full search, %u mismatches\n",
+           n, 100 * same / lookups, 100 * neighbour / lookups, 100 * search / lookups, mismatches);
+
+    // timed, best of 5 passes each
+    const auto now = []() { return std::chrono::steady_clock::now(); };
+    volatile size_t sink = 0;
+    double hinted_ns = 1e9, search_ns = 1e9;
+    for (int pass = 0; pass < 5; pass++)
+    {
+        size_t hint_rpm = 0, hint_map = 0;
+        auto t0 = now();
+        for (size_t i = 0; i < n; i++)
+            sink = find_bin(rpm_axis, 16, rpm[i], &hint_rpm) + find_bin(map_axis, 16, map[i], &hint_map);
+        hinted_ns = std::min(hinted_ns, std::chrono::duration<double, std::nano>(now() - t0).count() / lookups);
+
+        t0 = now();
+        for (size_t i = 0; i < n; i++)
+            sink = find_bin(rpm_axis, 16, rpm[i]) + find_bin(map_axis, 16, map[i]);
+        search_ns = std::min(search_ns, std::chrono::duration<double, std::nano>(now() - t0).count() / lookups);
+    }
+    (void)sink;
+    printf("%.2f ns per lookup with the hint, %.2f ns with the binary search\n", hinted_ns, search_ns);
+
+    return (mismatches == 0) && (same + neighbour > 0.95 * lookups) && (hinted_ns < max_ns) ? 0 : 1;
+}
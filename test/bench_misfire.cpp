@@ -0,0 +1,180 @@
+// Misfire detection on a 4 cylinder engine with a 36-1 crank wheel and a cam
+// edge. The crank speed comes from a torque model: each cylinder pushes in
+// the first half of its 180 deg segment against a load that grows with the
+// speed, a misfire leaves the segment without its push. Misfires are
+// injected at random, every count of gs.misfires is matched against them.
+// A segment is judged against its neighbours, two misfires in a row may hide
+// each other: they are counted apart.
+// Per-tooth cost of the segment tracking, from the replay time with and
+// without it.
+//
+// bench_misfire [max ns per tooth]
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+#include "sim.h"
+#include "synthetic.h"
+#include "trace_player.h"
+
+static Decoder dec;
+static GlobalState gs;
+
+static const double cam_deg = 90;
+static const uint n_cyl = 4;
+
+// Crank speed from the torque of the cylinders, integrated on the engine
+// time. drop: speed lost over a misfired segment at the target speed.
+class TorqueModel
+{
+    std::function<double(double)> target; // rpm the load settles at
+    double drop;
+    double t = 0, angle = 0, rpm;
+    long seg = -1;
+    bool fired = true;
+
+public:
+    std::mt19937 rng{1};
+    double misfire_rate = 0;
+    std::vector<std::pair<double, uint>> misfires; // segment start angle, cylinder
+
+    TorqueModel(std::function<double(double)> target_rpm, double misfire_drop)
+        : target(target_rpm), drop(misfire_drop), rpm(target_rpm(0)) {}
+
+    // calls come in time order
+    double operator()(double t_to)
+    {
+        for (; t < t_to; t += 1)
+        {
+            const long s = (long)std::floor(angle / 180);
+            if (s != seg)
+            {
+                seg = s;
+                fired = (angle < 720 * 20) || (std::uniform_real_distribution<>(0, 1)(rng) >= misfire_rate);
+                if (!fired)
+                    misfires.push_back({s * 180.0, (uint)(s % n_cyl)});
+            }
+            const double x = angle / 180 - s;
+            const double push = (fired && (x < 0.5)) ? M_PI * std::sin(2 * M_PI * x) : 0;
+            const double rpm_t = target(t);
+            const double k = drop * rpm_t / 180; // rpm per deg at a full push missing
+            const double deg = rpm * 6e-6;
+            rpm += k * (push - rpm / rpm_t) * deg;
+            angle += deg;
+        }
+        return rpm;
+    }
+};
+
+struct Result
+{
+    uint injected = 0, found = 0, wrong_cyl = 0, false_alarms = 0;
+    uint back_to_back = 0, back_to_back_found = 0; // misfire in the next or previous segment too
+    double ns_per_tooth = 0;
+};
+
+static Result run(std::function<double(double)> target, double drop, double rate, uint cylinders)
+{
+    decoder_reset(dec, gs);
+    dec.n_cylinders = cylinders;
+    TracePlayer player(dec, gs);
+    dec.enable_cam(player.cam_pin, (uint)(cam_deg * 0x10000 / 720));
+
+    TorqueModel model(target, drop);
+    model.misfire_rate = rate;
+    std::function<double(double)> rpm = std::ref(model);
+    SyntheticEngine engine(dec.wheel, rpm);
+    engine.cam_deg = cam_deg;
+
+    Result r;
+    uint32_t counted[DECODER_MAX_CYLINDERS] = {};
+    std::vector<bool> matched;
+    while (engine.angle_at(engine.now()) < 720 * 520)
+    {
+        player.edge(engine.next());
+        matched.resize(model.misfires.size());
+        const double now = engine.angle_at(engine.now());
+        for (uint c = 0; c < n_cyl; c++)
+        {
+            for (; counted[c] < gs.misfires[c]; counted[c]++)
+            {
+                // judged once the next segment is over, within a cycle
+                bool found = false, other = false;
+                for (size_t i = 0; i < model.misfires.size(); i++)
+                {
+                    if (matched[i] || (now - model.misfires[i].first > 720))
+                        continue;
+                    if (model.misfires[i].second == c)
+                    {
+                        matched[i] = found = true;
+                        break;
+                    }
+                    other = true;
+                }
+                r.found += found;
+                r.wrong_cyl += !found && other;
+                r.false_alarms += !found && !other;
+            }
+        }
+    }
+    r.injected = model.misfires.size();
+    for (size_t i = 0; i < model.misfires.size(); i++)
+    {
+        // judged against a neighbour that misfired too
+        const bool before = (i > 0) && (model.misfires[i].first - model.misfires[i - 1].first == 180);
+        const bool after = (i + 1 < model.misfires.size()) && (model.misfires[i + 1].first - model.misfires[i].first == 180);
+        if (before || after)
+        {
+            r.back_to_back += 1;
+            r.back_to_back_found += matched[i];
+        }
+    }
+    r.ns_per_tooth = player.finish().ns_per_tooth;
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    const double max_ns = (argc > 1) ? atof(argv[1]) : 1e9;
+    bool ok = true;
+
+    struct Case
+    {
+        const char *name;
+        std::function<double(double)> rpm;
+        double drop; // misfire speed drop, less at high speed
+    };
+    const Case cases[] = {
+        {"idle 800 rpm", [](double) { return 800.0; }, 0.06},
+        {"3000 rpm", [](double) { return 3000.0; }, 0.04},
+        {"6000 rpm", [](double) { return 6000.0; }, 0.03},
+        {"1000 to 6000 rpm in 10 s", [](double t) { return 1000 + 5000 * std::min(t / 10e6, 1.0); }, 0.04},
+    };
+    for (const Case &c : cases)
+    {
+        const Result clean = run(c.rpm, c.drop, 0, n_cyl);
+        const Result r = run(c.rpm, c.drop, 0.02, n_cyl);
+        const uint single = r.injected - r.back_to_back;
+        const uint single_found = r.found - r.back_to_back_found;
+        printf("%-24s %u/%u single misfires found, %u/%u back to back, %u wrong cylinder, "
+               "%u false alarms, %u without misfires\n",
+               c.name, single_found, single, r.back_to_back_found, r.back_to_back, r.wrong_cyl,
+               r.false_alarms, clean.false_alarms);
+        ok &= (single > 0) && (single_found == single) && (r.wrong_cyl == 0) && (r.false_alarms == 0) &&
+              (clean.false_alarms == 0);
+    }
+
+    // same trace with a single segment per cycle, judged twice per cycle only
+    double with = 0, without = 0;
+    for (int i = 0; i < 5; i++)
+    {
+        with += run([](double) { return 6000.0; }, 0.03, 0, n_cyl).ns_per_tooth;
+        without += run([](double) { return 6000.0; }, 0.03, 0, 1).ns_per_tooth;
+    }
+    const double cost = (with - without) / 5;
+    printf("segment tracking: %.1f ns per tooth (%.1f ns per tooth with it, %.1f without)\n",
+           cost, with / 5, without / 5);
+    ok &= cost < max_ns;
+    return ok ? 0 : 1;
+}
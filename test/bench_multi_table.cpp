@@ -0,0 +1,80 @@
+// VE, AFR and advance on the same 16x16 axes, as the main loop looks them
+// up: one batched lookup against three single ones. Total and per-table ns,
+// and the batched values must match the single lookups.
+//
+// bench_multi_table [max ns per batched lookup]
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "axis.h"
+
+static const int16_t x_points[16] = {500, 800, 1100, 1400, 1700, 2000, 2500, 3000,
+                                     3500, 4000, 4500, 5000, 5500, 6000, 6500, 7000};
+static const int16_t y_points[16] = {200, 250, 300, 350, 400, 450, 500, 550,
+                                     600, 650, 700, 750, 800, 900, 1000, 1050};
+static uint16_t ve_table[16 * 16], afr_table[16 * 16], adv_table[16 * 16];
+
+int main(int argc, char **argv)
+{
+    const double max_ns = (argc > 1) ? atof(argv[1]) : 1e9;
+    for (uint i = 0; i < 16 * 16; i++)
+    {
+        ve_table[i] = (uint16_t)(i * 251);
+        afr_table[i] = (uint16_t)(1470 - i);
+        adv_table[i] = (uint16_t)((i * 37) % 400);
+    }
+    static const uint16_t *const tables[] = {ve_table, afr_table, adv_table};
+
+    const size_t n = 1'000'000;
+    std::vector<int16_t> xs(n), ys(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        xs[i] = (int16_t)(3750 + 3200 * std::sin(i * 2e-5));
+        ys[i] = (int16_t)(625 + 420 * std::sin(i * 3e-5 + 1));
+    }
+
+    Axis<16> ax, ay;
+    ax.load(x_points);
+    ay.load(y_points);
+
+    const auto now = []() { return std::chrono::steady_clock::now(); };
+    const auto ns = [&](auto t0) { return std::chrono::duration<double, std::nano>(now() - t0).count() / n; };
+    volatile uint16_t sink;
+    double batched = 1e9, single = 1e9;
+    for (int pass = 0; pass < 5; pass++)
+    {
+        auto t0 = now();
+        for (size_t i = 0; i < n; i++)
+        {
+            uint16_t values[3];
+            bilinear_interp(ax, ay, tables, values, xs[i], ys[i]);
+            sink = values[0] + values[1] + values[2];
+        }
+        batched = std::min(batched, ns(t0));
+
+        t0 = now();
+        for (size_t i = 0; i < n; i++)
+        {
+            sink = bilinear_interp(ax, ay, ve_table, xs[i], ys[i]) + bilinear_interp(ax, ay, afr_table, xs[i], ys[i]) +
+                   bilinear_interp(ax, ay, adv_table, xs[i], ys[i]);
+        }
+        single = std::min(single, ns(t0));
+    }
+    (void)sink;
+
+    uint mismatches = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        uint16_t values[3];
+        bilinear_interp(ax, ay, tables, values, xs[i], ys[i]);
+        for (uint t = 0; t < 3; t++)
+            mismatches += (values[t] != bilinear_interp(ax, ay, tables[t], xs[i], ys[i]));
+    }
+    printf("3 tables: %.2f ns batched (%.2f ns per table), %.2f ns with single lookups (%.2f ns per table), "
+           "%u mismatches\n",
+           batched, batched / 3, single, single / 3, mismatches);
+    return (mismatches == 0) && (batched < max_ns) ? 0 : 1;
+}
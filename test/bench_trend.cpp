@@ -0,0 +1,93 @@
+// Angle error of the pulse ends under acceleration and deceleration: a 36-1
+// wheel, one output ending at 90 deg after 3 ms of pulse. The end is
+// predicted from the last tooth before the start. Built twice, with the
+// cycle time trend (bench_trend) and with a constant speed from the last
+// tooth (bench_trend_linear).
+//
+// bench_trend [max p95 error in deg]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "sim.h"
+#include "synthetic.h"
+#include "trace_player.h"
+
+static Decoder dec;
+static GlobalState gs;
+static Trigger trig;
+
+static const uint out_pin = 5;
+static const double end_deg = 90;
+static const uint pw = 3000;
+
+struct Profile
+{
+    const char *name;
+    std::function<double(double)> rpm;
+};
+
+// error of every pulse end, deg
+static std::vector<double> run(const Profile &p)
+{
+    decoder_reset(dec, gs);
+    trigger_reset(trig, out_pin);
+    TracePlayer player(dec, gs);
+    dec.set_output(0, &trig);
+    dec.request_output(0, (uint)(end_deg * 0x10000 / 720), pw);
+
+    SyntheticEngine engine(dec.wheel, p.rpm);
+    while (engine.now() < 2'000'000)
+        player.edge(engine.next());
+
+    std::vector<double> err;
+    for (const SimEdge &e : sim_edges)
+    {
+        if (e.high || (e.t < 100'000))
+            continue;
+        // without cam phase the output fires on every crank turn
+        err.push_back(angle_diff(engine.angle_at(e.t), end_deg, 360));
+    }
+    return err;
+}
+
+static double quantile(std::vector<double> v, double q)
+{
+    std::sort(v.begin(), v.end());
+    return v.empty() ? 0 : v[std::min(v.size() - 1, (size_t)(q * v.size()))];
+}
+
+int main(int argc, char **argv)
+{
+    const double max_p95 = (argc > 1) ? atof(argv[1]) : -1;
+    const Profile profiles[] = {
+        {"steady 3000 rpm", [](double) { return 3000.0; }},
+        {"accel 1000-7000 rpm/2s", [](double t) { return 1000 + 6000 * t / 2e6; }},
+        {"decel 7000-1000 rpm/2s", [](double t) { return 7000 - 6000 * t / 2e6; }},
+        {"accel 800-5800 rpm/0.5s", [](double t) { return 800 + 5000 * std::min(t / 0.5e6, 1.0); }},
+        {"decel 5800-800 rpm/0.5s", [](double t) { return 5800 - 5000 * std::min(t / 0.5e6, 1.0); }},
+    };
+    printf("%s: pulse end error, deg\n", DECODER_TREND_PREDICTION ? "cycle time trend" : "linear");
+    printf("%-26s %6s %8s %8s %8s %8s\n", "profile", "pulses", "mean", "p50|e|", "p95|e|", "max|e|");
+    bool fail = false;
+    for (const Profile &p : profiles)
+    {
+        const std::vector<double> err = run(p);
+        std::vector<double> abs_err;
+        double sum = 0;
+        for (const double e : err)
+        {
+            sum += e;
+            abs_err.push_back(std::fabs(e));
+        }
+        const double p95 = quantile(abs_err, 0.95);
+        printf("%-26s %6zu %8.3f %8.3f %8.3f %8.3f\n", p.name, err.size(), err.empty() ? 0 : sum / err.size(),
+               quantile(abs_err, 0.5), p95, quantile(abs_err, 1));
+        if (err.size() < 10)
+            fail = true;
+        if ((max_p95 >= 0) && (p95 > max_p95))
+            fail = true;
+    }
+    return fail ? 1 : 0;
+}
@@ -0,0 +1,32 @@
+// Decoder::update() per tooth on the host, against the libdivide divider
+// it rebuilt on every tooth before, the tooth log capture that must stay
+// under 100 ns per event and the angle clock queries (include/decoder_bench.h,
+// the same bench runs on target with DECODER_BENCH).
+
+#include <chrono>
+
+#include "decoder_bench.h"
+
+static Decoder dec;
+static GlobalState gs;
+
+int main()
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    const auto ns = [t0]() {
+        return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    };
+    const DecoderBenchResult r = decoder_bench(dec, gs, 200'000, ns, UINT32_MAX);
+    const uint32_t update = r.update - r.empty;
+    const uint32_t divide = r.libdivide - r.empty;
+    printf("update: %u ns per tooth now, %u ns with the per-tooth libdivide divider (+%u ns)\n",
+           update, update + divide, divide);
+    const double log_ns = (r.log_64 - r.empty) / 64.0;
+    printf("tooth log capture: %.2f ns per event\n", log_ns);
+    printf("angle clock per query: now_angle %.2f ns, %.2f ns with a divide from the last tooth; "
+           "angle_to_time %.2f ns, %.2f ns from the last tooth\n",
+           (r.now_angle_16 - r.empty) / 16.0, (r.angle_divide_16 - r.empty) / 16.0,
+           (r.to_time_16 - r.empty) / 16.0, (r.time_tooth_16 - r.empty) / 16.0);
+    printf("engine speed %u rpm, timer read %u ns\n", gs.engine_speed, r.empty);
+    return (gs.engine_speed > 5900) && (gs.engine_speed < 6100) && (log_ns < 100) ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+#ifndef __SHIM_HARDWARE_CLOCKS_H__
+#define __SHIM_HARDWARE_CLOCKS_H__
+
+#include "pico/stdlib.h"
+
+#define SIM_SYS_CLOCK_HZ 150'000'000
+
+enum clock_index
+{
+    clk_sys
+};
+
+static inline uint32_t clock_get_hz(clock_index) { return SIM_SYS_CLOCK_HZ; }
+
+#endif // __SHIM_HARDWARE_CLOCKS_H__
@@ -0,0 +1,6 @@
+#ifndef __SHIM_HARDWARE_GPIO_H__
+#define __SHIM_HARDWARE_GPIO_H__
+
+#include "pico/stdlib.h"
+
+#endif // __SHIM_HARDWARE_GPIO_H__
@@ -0,0 +1,23 @@
+#ifndef __SHIM_HARDWARE_IRQ_H__
+#define __SHIM_HARDWARE_IRQ_H__
+
+#include "pico/stdlib.h"
+
+enum
+{
+    TIMER0_IRQ_0,
+    PIO0_IRQ_0,
+    PIO1_IRQ_0,
+    PIO2_IRQ_0,
+    IO_IRQ_BANK0,
+    SIM_NUM_IRQS
+};
+#define PICO_HIGHEST_IRQ_PRIORITY 0x00
+#define PICO_DEFAULT_IRQ_PRIORITY 0x80
+
+typedef void (*irq_handler_t)();
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+static inline void irq_set_enabled(uint, bool) {}
+static inline void irq_set_priority(uint, uint8_t) {}
+
+#endif // __SHIM_HARDWARE_IRQ_H__
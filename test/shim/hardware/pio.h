@@ -0,0 +1,71 @@
+#ifndef __SHIM_HARDWARE_PIO_H__
+#define __SHIM_HARDWARE_PIO_H__
+
+#include "pico/stdlib.h"
+
+// State machines are not run, the simulation fills the RX FIFOs with
+// sim_pio_rx_push() and drops what is written to the TX FIFOs.
+#define NUM_PIOS 3
+#define NUM_PIO_STATE_MACHINES 4
+
+typedef struct pio_hw
+{
+    uint index;
+} pio_hw_t;
+typedef pio_hw_t *PIO;
+extern pio_hw_t sim_pio_hw[NUM_PIOS];
+#define pio0 (&sim_pio_hw[0])
+#define pio1 (&sim_pio_hw[1])
+#define pio2 (&sim_pio_hw[2])
+
+typedef struct
+{
+    const uint16_t *instructions;
+    uint8_t length;
+    int8_t origin;
+} pio_program_t;
+
+typedef struct
+{
+    uint32_t offset;
+} pio_sm_config;
+
+enum pio_interrupt_source
+{
+    pis_sm0_rx_fifo_not_empty = 0,
+};
+enum pio_fifo_join
+{
+    PIO_FIFO_JOIN_NONE,
+    PIO_FIFO_JOIN_TX,
+    PIO_FIFO_JOIN_RX,
+};
+
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm);
+uint32_t pio_sm_get(PIO pio, uint sm);
+static inline bool pio_sm_is_tx_fifo_full(PIO, uint) { return false; }
+static inline void pio_sm_put(PIO, uint, uint32_t) {}
+
+int pio_claim_unused_sm(PIO pio, bool required);
+void pio_sm_unclaim(PIO pio, uint sm);
+bool pio_can_add_program(PIO pio, const pio_program_t *program);
+static inline uint pio_add_program(PIO, const pio_program_t *) { return 0; }
+static inline void pio_remove_program(PIO, const pio_program_t *, uint) {}
+
+static inline void pio_set_irq0_source_enabled(PIO, pio_interrupt_source, bool) {}
+static inline void sm_config_set_jmp_pin(pio_sm_config *, uint) {}
+static inline void sm_config_set_sideset_pins(pio_sm_config *, uint) {}
+static inline void sm_config_set_out_shift(pio_sm_config *, bool, bool, uint) {}
+static inline void sm_config_set_fifo_join(pio_sm_config *, pio_fifo_join) {}
+static inline void pio_sm_set_consecutive_pindirs(PIO, uint, uint, uint, bool) {}
+static inline void pio_sm_init(PIO, uint, uint, const pio_sm_config *) {}
+static inline void pio_sm_set_enabled(PIO, uint, bool) {}
+static inline void pio_gpio_init(PIO, uint) {}
+static inline void pio_sm_clear_fifos(PIO, uint) {}
+static inline void pio_sm_restart(PIO, uint) {}
+static inline void pio_sm_exec(PIO, uint, uint) {}
+static inline uint pio_encode_nop() { return 0xa042; }
+static inline uint pio_encode_sideset_opt(uint, uint) { return 0; }
+static inline uint pio_encode_jmp(uint addr) { return addr; }
+
+#endif // __SHIM_HARDWARE_PIO_H__
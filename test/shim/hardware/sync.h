@@ -0,0 +1,10 @@
+#ifndef __SHIM_HARDWARE_SYNC_H__
+#define __SHIM_HARDWARE_SYNC_H__
+
+#include "pico/stdlib.h"
+
+// The simulation runs one handler at a time, nothing to mask
+static inline uint32_t save_and_disable_interrupts() { return 0; }
+static inline void restore_interrupts(uint32_t) {}
+
+#endif // __SHIM_HARDWARE_SYNC_H__
@@ -0,0 +1,21 @@
+#ifndef __SHIM_HARDWARE_TIMER_H__
+#define __SHIM_HARDWARE_TIMER_H__
+
+#include "pico/stdlib.h"
+
+typedef void (*hardware_alarm_callback_t)(uint alarm_num);
+int hardware_alarm_claim_unused(bool required);
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback);
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t);
+void hardware_alarm_cancel(uint alarm_num);
+
+// only read by the PIO output, which the simulation does not run
+typedef struct
+{
+    volatile uint32_t timerawl;
+} timer_hw_t;
+extern timer_hw_t *timer_hw;
+
+static inline void sleep_until(absolute_time_t) {}
+
+#endif // __SHIM_HARDWARE_TIMER_H__
@@ -0,0 +1,6 @@
+#ifndef __SHIM_PICO_SEM_H__
+#define __SHIM_PICO_SEM_H__
+
+#include "pico/stdlib.h"
+
+#endif // __SHIM_PICO_SEM_H__
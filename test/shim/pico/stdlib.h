@@ -0,0 +1,50 @@
+#ifndef __SHIM_PICO_STDLIB_H__
+#define __SHIM_PICO_STDLIB_H__
+
+// Host stand-in for the parts of the Pico SDK the firmware sources use.
+// Time, alarms, GPIO and IRQs are simulated in sim.cpp.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#ifndef PICO_ON_DEVICE
+#define PICO_ON_DEVICE 0
+#endif
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+typedef int32_t alarm_id_t;
+
+#define MIN(a, b) ((b) > (a) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define __not_in_flash_func(f) f
+
+#define NUM_BANK0_GPIOS 48
+#define GPIO_OUT 1
+#define GPIO_IN 0
+#define GPIO_IRQ_EDGE_RISE 0x8u
+#define GPIO_IRQ_EDGE_FALL 0x4u
+
+// time, advanced by the simulation only
+extern absolute_time_t sim_now;
+static inline uint64_t time_us_64() { return sim_now; }
+static inline uint32_t time_us_32() { return (uint32_t)sim_now; }
+static inline absolute_time_t get_absolute_time() { return sim_now; }
+static inline void tight_loop_contents() {}
+
+// alarm pool
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+alarm_id_t add_alarm_at(absolute_time_t time, alarm_callback_t callback, void *user_data, bool fire_if_past);
+bool cancel_alarm(alarm_id_t alarm_id);
+
+// GPIO
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_set_mask(uint32_t mask);
+void gpio_clr_mask(uint32_t mask);
+void gpio_put(uint gpio, bool value);
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback);
+
+#endif // __SHIM_PICO_STDLIB_H__
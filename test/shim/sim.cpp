@@ -0,0 +1,238 @@
+#include "sim.h"
+
+#include <deque>
+#include <map>
+
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/timer.h"
+
+absolute_time_t sim_now = 0;
+uint32_t sim_alarm_latency = 0;
+std::vector<SimEdge> sim_edges;
+bool sim_pio_outputs = false;
+std::function<void()> sim_edge_irq;
+
+pio_hw_t sim_pio_hw[NUM_PIOS] = {{0}, {1}, {2}};
+static timer_hw_t sim_timer_hw;
+timer_hw_t *timer_hw = &sim_timer_hw;
+
+// Alarm pool and hardware alarms share one queue ordered by target time,
+// hardware alarms use negative ids
+#define SIM_HW_ALARMS 4
+struct SimAlarm
+{
+    alarm_id_t id;
+    alarm_callback_t callback;
+    void *user_data;
+};
+static std::multimap<absolute_time_t, SimAlarm> alarms;
+static alarm_id_t next_alarm_id = 1;
+static hardware_alarm_callback_t hw_callbacks[SIM_HW_ALARMS];
+static uint hw_claimed = 0;
+
+static gpio_irq_callback_t gpio_callback = nullptr;
+static irq_handler_t irq_handlers[SIM_NUM_IRQS];
+static std::deque<uint32_t> rx_fifo[NUM_PIOS][NUM_PIO_STATE_MACHINES];
+static uint sm_claimed[NUM_PIOS];
+
+void sim_reset()
+{
+    sim_now = 0;
+    sim_alarm_latency = 0;
+    sim_edges.clear();
+    sim_pio_outputs = false;
+    sim_edge_irq = nullptr;
+    alarms.clear();
+    next_alarm_id = 1;
+    hw_claimed = 0;
+    for (auto &cb : hw_callbacks)
+        cb = nullptr;
+    gpio_callback = nullptr;
+    for (auto &h : irq_handlers)
+        h = nullptr;
+    for (auto &pio : rx_fifo)
+        for (auto &fifo : pio)
+            fifo.clear();
+    for (auto &claimed : sm_claimed)
+        claimed = 0;
+}
+
+static bool erase_alarm(alarm_id_t id)
+{
+    for (auto it = alarms.begin(); it != alarms.end(); ++it)
+    {
+        if (it->second.id == id)
+        {
+            alarms.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void sim_run_until(absolute_time_t t)
+{
+    while (!alarms.empty() && (alarms.begin()->first + sim_alarm_latency <= t))
+    {
+        const auto it = alarms.begin();
+        const absolute_time_t target = it->first;
+        const SimAlarm a = it->second;
+        alarms.erase(it);
+        if (sim_now < target + sim_alarm_latency)
+            sim_now = target + sim_alarm_latency;
+
+        if (a.id < 0)
+        {
+            hw_callbacks[-a.id - 1](-a.id - 1);
+            continue;
+        }
+        // >0: us after the callback ran, <0: us after the previous target
+        const int64_t next = a.callback(a.id, a.user_data);
+        if (next > 0)
+            alarms.insert({sim_now + next, a});
+        else if (next < 0)
+            alarms.insert({target - next, a});
+    }
+    if (sim_now < t)
+        sim_now = t;
+}
+
+uint sim_pending_alarms()
+{
+    return alarms.size();
+}
+
+alarm_id_t add_alarm_at(absolute_time_t time, alarm_callback_t callback, void *user_data, bool)
+{
+    // a time in the past fires on the next sim_run_until(), like the SDK
+    // firing from the alarm IRQ as soon as possible
+    const alarm_id_t id = next_alarm_id++;
+    alarms.insert({time, {id, callback, user_data}});
+    return id;
+}
+
+bool cancel_alarm(alarm_id_t alarm_id)
+{
+    return (alarm_id > 0) && erase_alarm(alarm_id);
+}
+
+int hardware_alarm_claim_unused(bool)
+{
+    return (hw_claimed < SIM_HW_ALARMS) ? (int)hw_claimed++ : -1;
+}
+
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback)
+{
+    hw_callbacks[alarm_num] = callback;
+}
+
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t)
+{
+    erase_alarm(-(alarm_id_t)alarm_num - 1);
+    alarms.insert({t, {-(alarm_id_t)alarm_num - 1, nullptr, nullptr}});
+    return false;
+}
+
+void hardware_alarm_cancel(uint alarm_num)
+{
+    erase_alarm(-(alarm_id_t)alarm_num - 1);
+}
+
+void gpio_init(uint) {}
+void gpio_set_dir(uint, bool) {}
+
+static void edge_irq()
+{
+    if (sim_edge_irq)
+    {
+        const std::function<void()> irq = sim_edge_irq;
+        sim_edge_irq = nullptr;
+        irq();
+    }
+}
+
+void gpio_set_mask(uint32_t mask)
+{
+    sim_edges.push_back({sim_now, mask, true});
+    edge_irq();
+}
+
+void gpio_clr_mask(uint32_t mask)
+{
+    sim_edges.push_back({sim_now, mask, false});
+    edge_irq();
+}
+
+void gpio_put(uint gpio, bool value)
+{
+    value ? gpio_set_mask(1u << gpio) : gpio_clr_mask(1u << gpio);
+}
+
+void gpio_set_irq_enabled_with_callback(uint, uint32_t, bool enabled, gpio_irq_callback_t callback)
+{
+    // one callback for all the pins, like the SDK
+    if (enabled)
+        gpio_callback = callback;
+}
+
+void sim_gpio_irq(uint gpio)
+{
+    if (gpio_callback)
+        gpio_callback(gpio, GPIO_IRQ_EDGE_RISE);
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler)
+{
+    irq_handlers[num] = handler;
+}
+
+void sim_irq(uint num)
+{
+    if (irq_handlers[num])
+        irq_handlers[num]();
+}
+
+void sim_pio_rx_push(uint pio_index, uint sm, uint32_t value)
+{
+    rx_fifo[pio_index][sm].push_back(value);
+}
+
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm)
+{
+    return rx_fifo[pio->index][sm].empty();
+}
+
+uint32_t pio_sm_get(PIO pio, uint sm)
+{
+    std::deque<uint32_t> &fifo = rx_fifo[pio->index][sm];
+    if (fifo.empty())
+        return 0;
+    const uint32_t value = fifo.front();
+    fifo.pop_front();
+    return value;
+}
+
+int pio_claim_unused_sm(PIO pio, bool)
+{
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++)
+    {
+        if (!(sm_claimed[pio->index] & (1u << sm)))
+        {
+            sm_claimed[pio->index] |= 1u << sm;
+            return sm;
+        }
+    }
+    return -1;
+}
+
+void pio_sm_unclaim(PIO pio, uint sm)
+{
+    sm_claimed[pio->index] &= ~(1u << sm);
+}
+
+bool pio_can_add_program(PIO pio, const pio_program_t *)
+{
+    // the PIO output runs on the last PIO
+    return sim_pio_outputs || (pio->index != NUM_PIOS - 1);
+}
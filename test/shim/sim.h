@@ -0,0 +1,43 @@
+#ifndef __SIM_H__
+#define __SIM_H__
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "pico/stdlib.h"
+
+// Simulated time and peripherals behind the SDK shims. Nothing runs on its
+// own: sim_run_until() fires the alarms due in time order, the trace player
+// raises the GPIO and PIO IRQs at the tooth times.
+
+struct SimEdge
+{
+    absolute_time_t t;
+    uint32_t mask; // output pins
+    bool high;
+};
+
+extern uint32_t sim_alarm_latency;   // 1 us, from alarm target to callback
+extern std::vector<SimEdge> sim_edges; // edges set by gpio_set_mask / gpio_clr_mask
+extern bool sim_pio_outputs;         // false: no PIO output state machine to claim
+// Run once right after the next output edge, an IRQ preempting the code
+// that set it
+extern std::function<void()> sim_edge_irq;
+
+// Back to time 0, alarms, IRQ handlers, FIFOs and edges cleared
+void sim_reset();
+// Fire every alarm due up to t in time order, then move the time to t
+void sim_run_until(absolute_time_t t);
+// Pending alarm pool and hardware alarms
+uint sim_pending_alarms();
+
+// GPIO IRQ on a rising edge of the input, at the current time
+void sim_gpio_irq(uint gpio);
+// Value pushed by a state machine into its RX FIFO, the FIFO IRQ is raised
+// separately with sim_irq()
+void sim_pio_rx_push(uint pio_index, uint sm, uint32_t value);
+// Run the handler set with irq_set_exclusive_handler()
+void sim_irq(uint num);
+
+#endif // __SIM_H__
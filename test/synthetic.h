@@ -0,0 +1,117 @@
+#ifndef __SYNTHETIC_H__
+#define __SYNTHETIC_H__
+
+#include <cmath>
+#include <functional>
+#include <vector>
+
+#include "trace_player.h"
+#include "wheel_pattern.h"
+
+// a - b within one turn of `turn` deg, -turn/2 to turn/2
+static inline double angle_diff(double a, double b, double turn)
+{
+    const double d = std::fmod(a - b, turn);
+    return (d > turn / 2) ? d - turn : (d < -turn / 2) ? d + turn : d;
+}
+
+// Engine turning at rpm(t), generates the crank and cam edges of a wheel and
+// keeps the true angle over time. Angles in degrees of a 720 deg cycle,
+// counted up from 0 at tooth 0 of the first wheel turn.
+class SyntheticEngine
+{
+    const WheelPattern &wheel;
+    std::function<double(double)> rpm; // engine speed at t in us
+    std::vector<double> history;       // angle every step from t = 0
+    double t = 0, angle;
+    double edge_t = 0; // time of the last edge
+    uint tooth = 0;    // next crank tooth
+    double turn = 0;   // angle of tooth 0 of the current wheel turn
+    double cam_next;   // angle of the next cam edge
+    double cam_next_deg = -1; // cam_deg cam_next was set from
+
+    static constexpr double step = 10; // us
+
+    double tooth_deg(uint i) const
+    {
+        return wheel.tooth_angle[i] * 720.0 / 0x10000;
+    }
+    void run_to(double target)
+    {
+        // midpoint integration on a fixed grid, history[i] is the angle at i * step
+        while (history.back() < target)
+        {
+            const double tg = (history.size() - 1) * step;
+            history.push_back(history.back() + rpm(tg + step / 2) * 6e-6 * step);
+        }
+        // the last step crosses the target, targets come in order
+        const size_t i = history.size() - 2;
+        t = (i + (target - history[i]) / (history[i + 1] - history[i])) * step;
+        angle = target;
+    }
+
+public:
+    double cam_deg = -1; // engine angle of the cam edge, <0 = no cam, may change any time
+
+    // start_deg: engine angle at t = 0
+    SyntheticEngine(const WheelPattern &w, std::function<double(double)> rpm_profile, double start_deg = 0)
+        : wheel(w), rpm(rpm_profile), angle(start_deg)
+    {
+        history.push_back(angle);
+        const double wheel_deg = wheel.wheel_angle * 720.0 / 0x10000;
+        turn = std::floor(start_deg / wheel_deg) * wheel_deg;
+        while ((tooth < wheel.n_teeth) && (turn + tooth_deg(tooth) <= start_deg))
+            tooth++;
+        if (tooth == wheel.n_teeth)
+        {
+            tooth = 0;
+            turn += wheel_deg;
+        }
+        cam_next = -1;
+    }
+
+    double now() const
+    {
+        return t;
+    }
+
+    // Next edge, period from the previous one
+    TraceEdge next()
+    {
+        if ((cam_deg >= 0) && ((cam_next < angle) || (cam_deg != cam_next_deg)))
+        {
+            // first edge, the cam came back or moved
+            cam_next_deg = cam_deg;
+            cam_next = std::floor(angle / 720) * 720 + cam_deg;
+            if (cam_next <= angle)
+                cam_next += 720;
+        }
+        const double crank_next = turn + tooth_deg(tooth);
+        const bool cam = (cam_deg >= 0) && (cam_next < crank_next);
+        run_to(cam ? cam_next : crank_next);
+        if (cam)
+        {
+            cam_next += 720;
+        }
+        else if (++tooth == wheel.n_teeth)
+        {
+            tooth = 0;
+            turn += wheel.wheel_angle * 720.0 / 0x10000;
+        }
+        const uint32_t period = (uint32_t)std::lround(t) - (uint32_t)std::lround(edge_t);
+        edge_t = t;
+        return {period, (uint8_t)(cam ? 1 : 0), (float)rpm(t)};
+    }
+
+    // Engine angle at time t_us, within what was generated so far
+    double angle_at(double t_us) const
+    {
+        const double pos = t_us / step;
+        const size_t i = (size_t)pos;
+        if (i + 1 >= history.size())
+            return angle;
+        return history[i] + (history[i + 1] - history[i]) * (pos - i);
+    }
+};
+
+#endif // __SYNTHETIC_H__
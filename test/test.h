@@ -0,0 +1,27 @@
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <cstdio>
+
+// Minimal checks for the host tests, a failed check is printed and the test
+// exits non-zero from test_result()
+static int test_failures = 0;
+
+#define CHECK(cond)                                                           \
+    do                                                                        \
+    {                                                                         \
+        if (!(cond))                                                          \
+        {                                                                     \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);   \
+            test_failures += 1;                                               \
+        }                                                                     \
+    } while (0)
+
+static inline int test_result()
+{
+    if (test_failures)
+        printf("%d check(s) failed\n", test_failures);
+    return test_failures ? 1 : 0;
+}
+
+#endif // __TEST_H__
@@ -0,0 +1,85 @@
+// Axis: the alpha from the precomputed reciprocal matches the division
+// 256 * (x - x0) / (x1 - x0) for every x of a bin, for every bin width up to
+// 2048 and for the widths around the powers of two up to the full int16
+// range. Lookups through an Axis give the same values as the division path,
+// inside and outside the axis.
+
+#include <random>
+
+#include "axis.h"
+#include "test.h"
+
+// one bin [0, width), every x
+static uint alpha_mismatches(int width)
+{
+    const int16_t points[2] = {(int16_t)(-32768 + 0), (int16_t)(-32768 + width)};
+    Axis<2> axis;
+    axis.load(points);
+    uint bad = 0;
+    for (int d = 0; d < width; d++)
+    {
+        uint32_t alpha;
+        axis.find((int16_t)(points[0] + d), &alpha);
+        bad += (alpha != 256U * d / width);
+    }
+    return bad;
+}
+
+int main()
+{
+    uint widths = 0, bad = 0;
+    for (int w = 1; w <= 2048; w++, widths++)
+        bad += alpha_mismatches(w);
+    for (int b = 12; b <= 16; b++)
+        for (int w = (1 << b) - 3; w <= (1 << b) + 3; w++)
+            if (w <= 65535)
+            {
+                bad += alpha_mismatches(w);
+                widths += 1;
+            }
+    printf("alpha: %u widths, every x, %u mismatches against the division\n", widths, bad);
+    CHECK(bad == 0);
+
+    // tables on random increasing axes, lookups inside and past both ends
+    std::mt19937 rng(1);
+    uint lookups = 0, diff = 0;
+    for (int k = 0; k < 200; k++)
+    {
+        int16_t xp[16], yp[16];
+        int x = -2000 + (int)(rng() % 1000), y = (int)(rng() % 500);
+        for (int i = 0; i < 16; i++)
+        {
+            xp[i] = (int16_t)x;
+            yp[i] = (int16_t)y;
+            x += 1 + rng() % 700;
+            y += 1 + rng() % 90;
+        }
+        uint16_t table[16 * 16];
+        for (uint16_t &v : table)
+            v = rng() % 65536;
+        Axis<16> ax, ay;
+        ax.load(xp);
+        ay.load(yp);
+        for (int i = 0; i < 500; i++)
+        {
+            const int16_t qx = (int16_t)(xp[0] - 100 + (int)(rng() % (xp[15] - xp[0] + 200)));
+            const int16_t qy = (int16_t)(yp[0] - 100 + (int)(rng() % (yp[15] - yp[0] + 200)));
+            diff += (linear_interp(ax, table, qx) != linear_interp(xp, 16, table, qx));
+            diff += (bilinear_interp(ax, ay, table, qx, qy) != bilinear_interp(xp, 16, yp, 16, table, qx, qy));
+            lookups += 2;
+        }
+    }
+    printf("lookups: %u, %u different from the division path\n", lookups, diff);
+    CHECK(diff == 0);
+
+    // a bin that is not increasing gets alpha 0, no division by zero
+    const int16_t flat[3] = {100, 100, 200};
+    Axis<3> axis;
+    axis.load(flat);
+    uint32_t alpha;
+    CHECK(axis.find(150, &alpha) == 1);
+    CHECK(alpha == 128);
+    CHECK(axis.recip[0] == 0);
+
+    return test_result();
+}
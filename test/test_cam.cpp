@@ -0,0 +1,139 @@
+// 36-1 crank wheel with a cam edge per cycle: the phase is found and right,
+// a lost cam falls back to wasted spark without losing the crank sync, and
+// noise edges neither flip the phase nor break the sync.
+
+#include <cmath>
+#include <random>
+
+#include "sim.h"
+#include "synthetic.h"
+#include "test.h"
+#include "trace_player.h"
+
+static Decoder dec;
+static GlobalState gs;
+
+static const double cam_deg = 90;
+
+struct CamRun
+{
+    TracePlayer player;
+    SyntheticEngine engine;
+    uint wrong_phase = 0; // teeth with cam sync and the wrong 720 deg angle
+
+    CamRun(double start_deg, double rpm)
+        : player(dec, gs), engine(dec.wheel, [rpm](double) { return rpm; }, start_deg)
+    {
+        engine.cam_deg = cam_deg;
+    }
+    void edge(const TraceEdge &e)
+    {
+        player.edge(e);
+        if (e.input || !gs.cam_sync)
+            return;
+        const uint angle = (dec.cam_phase + dec.wheel.tooth_angle[dec.sync_count]) & 0xFFFF;
+        if (std::fabs(angle_diff(engine.angle_at(engine.now()), angle * 720.0 / 0x10000, 720)) > 0.01)
+            wrong_phase += 1;
+    }
+    void turns(double n)
+    {
+        const double end = engine.angle_at(engine.now()) + 360 * n;
+        while (engine.angle_at(engine.now()) < end)
+            edge(engine.next());
+    }
+};
+
+static void reset()
+{
+    decoder_reset(dec, gs);
+    dec.enable_cam(1, (uint)(cam_deg * 0x10000 / 720));
+}
+
+int main()
+{
+    // phase found from both crank turns
+    for (double start = 0; start < 720; start += 45)
+    {
+        reset();
+        CamRun run(start, 3000);
+        run.turns(6);
+        CHECK(gs.cam_sync);
+        CHECK(run.wrong_phase == 0);
+        CHECK(gs.cam_noise == 0);
+        CHECK(run.player.finish().sync_losses == 0);
+    }
+
+    // cam lost for 10 turns then back
+    {
+        reset();
+        CamRun run(0, 3000);
+        run.turns(6);
+        CHECK(gs.cam_sync);
+        run.engine.cam_deg = -1;
+        run.turns(10);
+        printf("cam lost: cam_sync %d, %u losses\n", gs.cam_sync, gs.cam_losses);
+        CHECK(!gs.cam_sync);
+        CHECK(gs.cam_losses == 1);
+        CHECK(dec.sync_step == 3);
+        run.engine.cam_deg = cam_deg;
+        run.turns(6);
+        CHECK(gs.cam_sync);
+        CHECK(run.wrong_phase == 0);
+        CHECK(run.player.finish().sync_losses == 0);
+    }
+
+    // random noise edges, one per turn on average, anywhere in the cycle
+    {
+        reset();
+        CamRun run(200, 3000);
+        run.turns(6);
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> where(0, 1);
+        uint noise = 0;
+        for (uint i = 0; i < 2000; i++)
+        {
+            TraceEdge e = run.engine.next();
+            if (where(rng) < 1.0 / 35)
+            {
+                // noise edge inside the gap before e
+                const uint32_t before = (uint32_t)(e.period * where(rng));
+                run.edge({before, 1, 0});
+                e.period -= before;
+                noise += 1;
+            }
+            run.edge(e);
+        }
+        printf("cam noise: %u edges injected, %u counted, cam_sync %d, %u wrong phase teeth\n",
+               noise, gs.cam_noise, gs.cam_sync, run.wrong_phase);
+        CHECK(gs.cam_noise > noise / 2);
+        CHECK(gs.cam_sync);
+        CHECK(run.wrong_phase == 0);
+        CHECK(run.player.finish().sync_losses == 0);
+    }
+
+    // a single extra edge 360 deg off does not flip a confirmed phase
+    {
+        reset();
+        CamRun run(0, 3000);
+        run.turns(6);
+        bool injected = false;
+        while (!injected)
+        {
+            TraceEdge e = run.engine.next();
+            if (!e.input && (std::fmod(run.engine.angle_at(run.engine.now()), 720) > cam_deg + 360))
+            {
+                run.edge({e.period / 2, 1, 0});
+                e.period -= e.period / 2;
+                injected = true;
+            }
+            run.edge(e);
+        }
+        run.turns(4);
+        CHECK(gs.cam_noise == 1);
+        CHECK(gs.cam_sync);
+        CHECK(run.wrong_phase == 0);
+        CHECK(run.player.finish().sync_losses == 0);
+    }
+
+    return test_result();
+}
@@ -0,0 +1,165 @@
+// Coil on its own: the spark comes first, a late tooth shortens the dwell
+// but never delays the spark, a charging coil only moves its spark, and the
+// dwell is clamped to leave the coil time to discharge. From the decoder,
+// the dwell follows the battery voltage through the coil curve.
+
+#include <new>
+
+#include "sim.h"
+#include "synthetic.h"
+#include "test.h"
+#include "trace_player.h"
+
+static Coil coil;
+static const uint pin = 5;
+
+static void reset()
+{
+    sim_reset();
+    coil.~Coil();
+    new (&coil) Coil();
+    coil.init(pin);
+}
+
+// edges of the pin as (time, high) pairs, compared to the expected ones
+static bool edges_are(std::initializer_list<std::pair<absolute_time_t, bool>> expected)
+{
+    std::vector<std::pair<absolute_time_t, bool>> got;
+    for (const SimEdge &e : sim_edges)
+        if (e.mask & (1u << pin))
+            got.push_back({e.t, e.high});
+    const bool same = (got == std::vector<std::pair<absolute_time_t, bool>>(expected));
+    if (!same)
+    {
+        for (auto &g : got)
+            printf("  %llu %s\n", (unsigned long long)g.first, g.second ? "high" : "low");
+    }
+    return same;
+}
+
+static Decoder dec;
+static GlobalState gs;
+
+// dwell of every spark from the decoder at 1500 rpm, min..max
+static void decoder_dwell(int16_t battery_voltage, uint request_pw, uint *min, uint *max)
+{
+    decoder_reset(dec, gs);
+    coil.~Coil();
+    new (&coil) Coil();
+    coil.init(pin);
+    gs.battery_voltage = battery_voltage;
+    dec.set_output(0, &coil);
+    dec.request_output(0, 0x2000, request_pw);
+    TracePlayer player(dec, gs);
+    SyntheticEngine engine(dec.wheel, [](double) { return 1500.0; });
+    while (engine.now() < 1e6)
+        player.edge(engine.next());
+
+    *min = UINT32_MAX;
+    *max = 0;
+    absolute_time_t high_at = 0;
+    for (const SimEdge &e : sim_edges)
+    {
+        if (!(e.mask & (1u << pin)))
+            continue;
+        if (e.high)
+        {
+            high_at = e.t;
+        }
+        else if (high_at)
+        {
+            *min = MIN(*min, (uint)(e.t - high_at));
+            *max = MAX(*max, (uint)(e.t - high_at));
+        }
+    }
+}
+
+int main()
+{
+    // dwell ends at the spark
+    reset();
+    coil.update(0, 10000, 3000, 20000);
+    sim_run_until(20000);
+    CHECK(edges_are({{7000, true}, {10000, false}}));
+    CHECK(!coil.busy());
+    CHECK(sim_pending_alarms() == 0);
+
+    // retimed before the dwell starts, both edges move
+    reset();
+    coil.update(0, 10000, 3000, 20000);
+    sim_run_until(1000);
+    coil.update(1000, 12000, 3000, 20000);
+    sim_run_until(20000);
+    CHECK(edges_are({{9000, true}, {12000, false}}));
+
+    // late tooth: shorter dwell, the spark stays on time
+    reset();
+    coil.update(8000, 10000, 3000, 20000);
+    sim_run_until(20000);
+    CHECK(edges_are({{8000, true}, {10000, false}}));
+
+    // charging, a tooth moves the spark earlier, then later within the dwell limit
+    reset();
+    coil.update(0, 10000, 3000, 20000);
+    sim_run_until(8000);
+    coil.update(8000, 9500, 3000, 20000);
+    sim_run_until(9000);
+    coil.update(9000, 11000, 3000, 20000);
+    sim_run_until(20000);
+    CHECK(edges_are({{7000, true}, {11000, false}}));
+
+    // charging, a spark past 1.5 x the dwell fires now rather than hold the coil
+    reset();
+    coil.update(0, 10000, 3000, 20000);
+    sim_run_until(8000);
+    coil.update(8000, 12000, 3000, 20000);
+    sim_run_until(20000);
+    CHECK(edges_are({{7000, true}, {8000, false}}));
+
+    // short spark period: the dwell leaves min_off to discharge
+    reset();
+    coil.update(0, 10000, 3000, 3000);
+    sim_run_until(20000);
+    CHECK(edges_are({{8000, true}, {10000, false}}));
+
+    // no time at all to charge: no dwell, counted as missed
+    reset();
+    coil.update(0, 10000, 3000, coil.min_off);
+    sim_run_until(20000);
+    CHECK(edges_are({}));
+    CHECK(coil.stats.missed == 1);
+    CHECK(!coil.busy());
+
+    // cancelled while charging: low at once, no spark alarm left
+    reset();
+    coil.update(0, 10000, 3000, 20000);
+    sim_run_until(8000);
+    coil.cancel();
+    sim_run_until(20000);
+    CHECK(edges_are({{7000, true}, {8000, false}}));
+    CHECK(sim_pending_alarms() == 0);
+
+    // dwell curve, clamped past both ends
+    reset();
+    CHECK(coil.dwell(800) == 6000);
+    CHECK(coil.dwell(1250) == 3250);
+    CHECK(coil.dwell(500) == 6000);
+    // the last point is reached to the 8 bit alpha
+    CHECK((coil.dwell(1600) >= 2300) && (coil.dwell(1600) <= 2300 + 4));
+    CHECK(coil.dwell(1800) == coil.dwell(1600));
+
+    // from the decoder: the dwell follows the battery, the request pw caps it.
+    // The spark is retimed from each tooth while charging, a few us apart.
+    uint min, max;
+    decoder_dwell(1000, 0xFFFF, &min, &max);
+    printf("10.0 V: dwell %u..%u us\n", min, max);
+    CHECK((min >= 4500 - 10) && (max <= 4500 + 10));
+    decoder_dwell(1400, 0xFFFF, &min, &max);
+    printf("14.0 V: dwell %u..%u us\n", min, max);
+    CHECK((min >= 2700 - 10) && (max <= 2700 + 10));
+    decoder_dwell(1000, 2000, &min, &max);
+    printf("10.0 V, 2000 us request: dwell %u..%u us\n", min, max);
+    CHECK((min >= 2000 - 10) && (max <= 2000 + 10));
+
+    return test_result();
+}
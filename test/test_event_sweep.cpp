@@ -0,0 +1,136 @@
+// Event table from 100 to 12000 rpm: four injector outputs on a 36-1 crank
+// wheel with a cam edge, one pulse per output and cycle. Every time the
+// engine passes the end angle of an output, a pulse of that output must end
+// there: no missed pulse, no extra one. Cranking also runs on 24-1 and 60-2.
+// Everything runs again with the decoder in the tooth IRQ and no main loop.
+
+#include <algorithm>
+
+#include "sim.h"
+#include "synthetic.h"
+#include "test.h"
+#include "trace_player.h"
+
+static Decoder dec;
+static GlobalState gs;
+static Trigger trig[4];
+static const uint first_pin = 5;
+static const double cam_deg = 90;
+static const double end_deg[4] = {10, 190, 370, 550};
+static const uint pw = 3000;
+static const double tolerance = 3; // deg
+
+struct Sweep
+{
+    uint expected = 0, missed = 0, extra = 0, sync_losses = 0;
+    double max_error = 0; // deg
+};
+
+// irq: the tooth IRQ runs the decoder and arms the outputs, no main loop
+static Sweep run(std::function<double(double)> rpm, double duration_us, const char *wheel, bool irq)
+{
+    decoder_reset(dec, gs, wheel);
+    TracePlayer player(dec, gs);
+    if (irq)
+    {
+        dec.enable_irq_processing();
+        player.main_loop = false;
+    }
+    dec.enable_cam(player.cam_pin, (uint)(cam_deg * 0x10000 / 720));
+    for (uint i = 0; i < 4; i++)
+    {
+        trigger_reset(trig[i], first_pin + i);
+        dec.set_output(i, &trig[i]);
+        dec.request_output(i, (uint)(end_deg[i] * 0x10000 / 720), pw);
+    }
+
+    SyntheticEngine engine(dec.wheel, rpm);
+    engine.cam_deg = cam_deg;
+    absolute_time_t phased_at = 0;
+    while (engine.now() < duration_us)
+    {
+        player.edge(engine.next());
+        if (!phased_at && gs.cam_sync)
+            phased_at = sim_now;
+    }
+    const absolute_time_t end = sim_now;
+
+    // from one cycle after the phase was found, to a cycle before the end
+    Sweep s;
+    s.sync_losses = player.finish().sync_losses;
+    if (!phased_at)
+    {
+        s.missed = 1;
+        return s;
+    }
+    const double from = engine.angle_at(phased_at) + 720;
+    const double to = engine.angle_at(end) - 720;
+    for (uint i = 0; i < 4; i++)
+    {
+        std::vector<double> ends;
+        for (const SimEdge &e : sim_edges)
+            if (!e.high && (e.mask & (1u << (first_pin + i))))
+                ends.push_back(engine.angle_at(e.t));
+        std::vector<bool> used(ends.size());
+        for (double a = std::ceil((from - end_deg[i]) / 720) * 720 + end_deg[i]; a < to; a += 720)
+        {
+            s.expected += 1;
+            bool found = false;
+            for (size_t k = 0; k < ends.size(); k++)
+            {
+                if (!used[k] && (std::fabs(ends[k] - a) < tolerance))
+                {
+                    used[k] = found = true;
+                    s.max_error = std::max(s.max_error, std::fabs(ends[k] - a));
+                    break;
+                }
+            }
+            s.missed += !found;
+        }
+        for (size_t k = 0; k < ends.size(); k++)
+            s.extra += !used[k] && (ends[k] > from + tolerance) && (ends[k] < to - tolerance);
+    }
+    return s;
+}
+
+static bool report(const char *name, const Sweep &s)
+{
+    printf("%-31s %4u pulses, %u missed, %u extra, %.2f deg max end error, %u sync losses\n",
+           name, s.expected, s.missed, s.extra, s.max_error, s.sync_losses);
+    return (s.expected > 0) && (s.missed == 0) && (s.extra == 0) && (s.sync_losses == 0);
+}
+
+int main()
+{
+    // outputs armed from the main loop, then from the tooth IRQ with no main loop
+    for (bool irq : {false, true})
+    {
+        const char *mode = irq ? "irq, " : "";
+        char name[48];
+        static const double rpms[] = {100, 200, 400, 800, 1500, 3000, 6000, 9000, 12000};
+        for (double rpm : rpms)
+        {
+            snprintf(name, sizeof(name), "%s%.0f rpm", mode, rpm);
+            // 20 cycles
+            CHECK(report(name, run([rpm](double) { return rpm; }, 20 * 120e6 / rpm, "36-1", irq)));
+        }
+        snprintf(name, sizeof(name), "%s1000 to 12000 rpm in 4 s", mode);
+        CHECK(report(name, run([](double t) {
+            return 1000 + 11000 * std::min(t / 4e6, 1.0);
+        }, 5e6, "36-1", irq)));
+        snprintf(name, sizeof(name), "%s12000 to 1000 rpm in 4 s", mode);
+        CHECK(report(name, run([](double t) {
+            return 12000 - 11000 * std::min(t / 4e6, 1.0);
+        }, 5e6, "36-1", irq)));
+        for (const char *wheel : {"36-1", "24-1", "60-2"})
+        {
+            snprintf(name, sizeof(name), "%scranking 100 to 300, %s", mode, wheel);
+            CHECK(report(name, run([](double t) {
+                const double rpm = 100 + 200 * std::min(t / 6e6, 1.0);
+                return rpm * (1 + 0.2 * std::sin(2 * M_PI * t * rpm / 60e6 * 2));
+            }, 8e6, wheel, irq)));
+        }
+    }
+
+    return test_result();
+}
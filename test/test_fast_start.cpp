@@ -0,0 +1,113 @@
+// Stop position: persisted only once the engine really stopped, not on a
+// stall the teeth come back from, and used by the next start. Time from
+// the first tooth to the first output pulse with and without it.
+
+#include <cmath>
+
+#include "sim.h"
+#include "synthetic.h"
+#include "test.h"
+#include "trace_player.h"
+
+static Decoder dec;
+static GlobalState gs;
+static Trigger trig;
+static const uint out_pin = 5;
+
+static void reset()
+{
+    decoder_reset(dec, gs);
+    trigger_reset(trig, out_pin);
+    dec.set_output(0, &trig);
+    dec.request_output(0, 0x3000, 2000); // ends at 135 deg
+}
+
+static double cranking(double t)
+{
+    return 200 + 25 * std::sin(2 * M_PI * t * 200 / 60e6 * 2);
+}
+
+// Crank from start_deg until the first output pulse, time from the first
+// tooth to its rising edge in us
+static double first_event(TracePlayer &player, double start_deg)
+{
+    SyntheticEngine engine(dec.wheel, cranking, start_deg);
+    const size_t edges = sim_edges.size();
+    absolute_time_t first_tooth = 0;
+    while (engine.now() < 2e6)
+    {
+        player.edge(engine.next());
+        if (!first_tooth)
+            first_tooth = sim_now;
+        for (size_t i = edges; i < sim_edges.size(); i++)
+            if (sim_edges[i].high)
+                return sim_edges[i].t - first_tooth;
+    }
+    return -1;
+}
+
+int main()
+{
+    uint stops = 0;
+    double fast_sum = 0, cold_sum = 0, fast_max = 0, cold_max = 0;
+    uint runs = 0;
+    for (double stop_deg = 3; stop_deg < 720; stop_deg += 29)
+    {
+        // run, then stop between two teeth
+        reset();
+        TracePlayer player(dec, gs);
+        SyntheticEngine run(dec.wheel, [](double) { return 900.0; });
+        while (run.angle_at(run.now()) < 720 * 3 + stop_deg)
+            player.edge(run.next());
+        const double stopped_at = run.angle_at(run.now());
+
+        // stalled but not stopped yet, nothing to persist
+        player.idle(200'000);
+        CHECK(dec.sync_step == 0);
+        CHECK(!dec.check_stop(sim_now));
+        player.idle(DECODER_STOP_US);
+        CHECK(dec.check_stop(sim_now));
+        CHECK(!dec.check_stop(sim_now)); // once per stop
+        const double stop_tooth = dec.wheel.tooth_angle[dec.stop_tooth] * 720.0 / 0x10000;
+        CHECK(std::fabs(angle_diff(stopped_at, stop_tooth, 360)) < 0.01);
+        CHECK(dec.fast_start_tooth == (int)dec.stop_tooth);
+        stops += 1;
+
+        // restart from where it stopped, against a decoder that knows nothing
+        const uint losses = player.finish().sync_losses; // the stop
+        const double fast = first_event(player, stopped_at + 0.5);
+        CHECK(player.finish().sync_losses == losses);
+        CHECK(gs.fast_start_aborts == 0);
+        reset();
+        TracePlayer cold_player(dec, gs);
+        const double cold = first_event(cold_player, stopped_at + 0.5);
+        CHECK((fast > 0) && (cold > 0));
+        fast_sum += fast;
+        cold_sum += cold;
+        fast_max = std::max(fast_max, fast);
+        cold_max = std::max(cold_max, cold);
+        runs += 1;
+    }
+    printf("%u stops persisted once\n", stops);
+    printf("first tooth to first pulse at 200 rpm cranking: fast start %.1f ms mean, %.1f ms max; "
+           "cold %.1f ms mean, %.1f ms max\n",
+           fast_sum / runs / 1000, fast_max / 1000, cold_sum / runs / 1000, cold_max / 1000);
+    CHECK(fast_sum < cold_sum);
+
+    // teeth in the ring while the main loop is late: no stall, nothing to persist
+    reset();
+    TracePlayer player(dec, gs);
+    SyntheticEngine run(dec.wheel, [](double) { return 3000.0; });
+    while (run.now() < 300'000)
+        player.edge(run.next());
+    player.main_loop = false;
+    while (run.now() < 310'000)
+        player.edge(run.next());
+    CHECK(!dec.check_stop(sim_now + DECODER_STOP_US + 1));
+    player.main_loop = true;
+    player.update();
+    CHECK(dec.sync_step == 3);
+    CHECK(!dec.stop_pending);
+
+    return test_result();
+}
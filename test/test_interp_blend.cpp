@@ -0,0 +1,136 @@
+// Portable InterpBlend against the interpolator blend: the exact
+// interpolation base0 + (base1 - base0) * alpha / 256 rounded down, alpha
+// the low 8 bits. Hand computed vectors, both signs of base1 - base0, then
+// every alpha on a grid of base pairs and random pairs, and full table
+// lookups against the same interpolation done in floating point from the
+// axis division. Lookups run this same class on the host.
+
+#include <cmath>
+#include <random>
+
+#include "linear_interp.h"
+#include "test.h"
+
+// exact in a double for 16 bit bases
+static uint16_t blend_exact(uint16_t base0, uint16_t base1, uint32_t alpha)
+{
+    return (uint16_t)std::floor(base0 + ((double)base1 - base0) * (alpha & 0xFF) / 256);
+}
+
+static uint16_t linear_exact(const int16_t *xp, size_t n, const uint16_t *table, int16_t x)
+{
+    x = std::min(std::max(x, xp[0]), (int16_t)(xp[n - 1] - 1));
+    size_t i = 0;
+    while (x >= xp[i + 1])
+        i++;
+    return blend_exact(table[i], table[i + 1], 256 * (x - xp[i]) / (xp[i + 1] - xp[i]));
+}
+
+static uint16_t bilinear_exact(const int16_t *xp, size_t nx, const int16_t *yp, size_t ny, const uint16_t *table,
+                               int16_t x, int16_t y)
+{
+    x = std::min(std::max(x, xp[0]), (int16_t)(xp[nx - 1] - 1));
+    y = std::min(std::max(y, yp[0]), (int16_t)(yp[ny - 1] - 1));
+    size_t ix = 0, iy = 0;
+    while (x >= xp[ix + 1])
+        ix++;
+    while (y >= yp[iy + 1])
+        iy++;
+    const uint32_t ax = 256 * (x - xp[ix]) / (xp[ix + 1] - xp[ix]);
+    const uint32_t ay = 256 * (y - yp[iy]) / (yp[iy + 1] - yp[iy]);
+    const uint16_t *row = table + iy * nx + ix;
+    return blend_exact(blend_exact(row[0], row[1], ax), blend_exact(row[nx], row[nx + 1], ax), ay);
+}
+
+int main()
+{
+    InterpBlend interp;
+    const auto blend = [&](uint16_t b0, uint16_t b1, uint32_t alpha) {
+        interp.alpha(alpha);
+        return interp.blend(b0 | ((uint32_t)b1 << 16));
+    };
+
+    // by hand: rising and falling, rounded down in both directions
+    static const struct
+    {
+        uint16_t base0, base1;
+        uint32_t alpha;
+        uint16_t result;
+    } golden[] = {
+        {0, 256, 128, 128},      {256, 0, 128, 128},      {100, 200, 1, 100},
+        {200, 100, 1, 199},      {999, 1000, 255, 999},   {1000, 999, 255, 999},
+        {1000, 999, 1, 999},     {0, 0xFFFF, 255, 65279}, {0xFFFF, 0, 255, 255},
+        {0xFFFF, 0, 1, 65279},   {0xFFFF, 0, 0, 0xFFFF},  {0x8000, 0x7FFF, 128, 0x7FFF},
+        {0x7FFF, 0x8000, 128, 0x7FFF}, {1470, 1200, 64, 1402}, {1200, 1470, 64, 1267},
+        {500, 500, 200, 500},
+    };
+    for (const auto &g : golden)
+    {
+        const uint16_t r = blend(g.base0, g.base1, g.alpha);
+        if (r != g.result)
+            printf("  blend(%u, %u, %u) = %u, expected %u\n", g.base0, g.base1, g.alpha, r, g.result);
+        CHECK(r == g.result);
+    }
+
+    uint64_t checked = 0, mismatches = 0;
+    const auto check = [&](uint16_t b0, uint16_t b1, uint32_t alpha) {
+        mismatches += (blend(b0, b1, alpha) != blend_exact(b0, b1, alpha));
+        checked += 1;
+    };
+
+    // grid with both ends and the sign boundary of the difference
+    std::vector<uint16_t> grid = {0, 1, 2, 0x7FFE, 0x7FFF, 0x8000, 0x8001, 0xFFFE, 0xFFFF};
+    for (uint v = 0; v < 0x10000; v += 257)
+        grid.push_back((uint16_t)v);
+    for (uint16_t b0 : grid)
+        for (uint16_t b1 : grid)
+            for (uint32_t alpha = 0; alpha < 256; alpha++)
+                check(b0, b1, alpha);
+
+    std::mt19937 rng(1);
+    for (uint i = 0; i < 1'000'000; i++)
+        check((uint16_t)rng(), (uint16_t)rng(), rng() % 256);
+
+    // alpha past 8 bits wraps like the hardware accumulator lane
+    for (uint32_t alpha : {256u, 257u, 511u, 0x1234u})
+        check(100, 200, alpha);
+
+    printf("%llu blends, %llu different from the exact interpolation\n", (unsigned long long)checked,
+           (unsigned long long)mismatches);
+    CHECK(mismatches == 0);
+
+    // lookups on random increasing axes and tables, inside and past both ends
+    uint lookups = 0, diff = 0;
+    for (int k = 0; k < 200; k++)
+    {
+        int16_t xp[16], yp[16];
+        int x = -2000 + (int)(rng() % 1000), y = (int)(rng() % 500);
+        for (int i = 0; i < 16; i++)
+        {
+            xp[i] = (int16_t)x;
+            yp[i] = (int16_t)y;
+            x += 1 + rng() % 700;
+            y += 1 + rng() % 90;
+        }
+        uint16_t table[16 * 16];
+        for (uint16_t &v : table)
+            v = rng() % 65536;
+        for (int i = 0; i < 500; i++)
+        {
+            const int16_t qx = (int16_t)(xp[0] - 100 + (int)(rng() % (xp[15] - xp[0] + 200)));
+            const int16_t qy = (int16_t)(yp[0] - 100 + (int)(rng() % (yp[15] - yp[0] + 200)));
+            diff += (linear_interp(xp, 16, table, qx) != linear_exact(xp, 16, table, qx));
+            diff += (bilinear_interp(xp, 16, yp, 16, table, qx, qy) != bilinear_exact(xp, 16, yp, 16, table, qx, qy));
+            lookups += 2;
+        }
+    }
+    printf("lookups: %u, %u different from the exact interpolation\n", lookups, diff);
+    CHECK(diff == 0);
+
+    // consecutive blends keep the alpha, like the hardware lane
+    interp.alpha(128);
+    CHECK(interp.blend(0 | (200u << 16)) == 100);
+    CHECK(interp.blend(1000 | (0u << 16)) == 500);
+
+    return test_result();
+}
@@ -0,0 +1,126 @@
+// Stall: the engine stops dead between two teeth. The hardware alarm must
+// shut the outputs down one timeout after the last tooth, whatever the main
+// loop does. Latency from the last tooth to shutdown, against the timeout:
+// 25% over the expected gap, twice the gap at cranking speed. 36-1, 24-1 and
+// 60-2 wheels, and cranking with compression ripple must not stall early.
+// Again with the decoder in the tooth IRQ and no main loop at all.
+
+#include <algorithm>
+
+#include "sim.h"
+#include "synthetic.h"
+#include "test.h"
+#include "trace_player.h"
+
+static Decoder dec;
+static GlobalState gs;
+static Trigger trig;
+static const uint out_pin = 5;
+
+static void reset(const char *wheel)
+{
+    decoder_reset(dec, gs, wheel);
+    trigger_reset(trig, out_pin);
+    dec.set_output(0, &trig);
+}
+
+static bool pin_high()
+{
+    bool high = false;
+    for (const SimEdge &e : sim_edges)
+        if (e.mask & (1u << out_pin))
+            high = e.high;
+    return high;
+}
+
+struct Stall
+{
+    uint runs = 0, in_pulse = 0, sync_losses = 0;
+    double sum = 0, worst = 0, worst_ratio = 0;
+};
+
+static const uint32_t alarm_latency = 3; // us
+
+// run up to stop_deg, then stop dead. irq: the tooth IRQ runs the decoder.
+static void stop_at(Stall &s, const char *wheel, std::function<double(double)> rpm, double stop_deg, bool irq)
+{
+    reset(wheel);
+    if (irq)
+        dec.enable_irq_processing();
+    sim_alarm_latency = alarm_latency;
+    // long pulses, the stop often comes while one is running
+    dec.request_output(0, 0x4000, (uint)(60e6 / rpm(0) / 2));
+    TracePlayer player(dec, gs);
+    player.main_loop = !irq;
+    SyntheticEngine engine(dec.wheel, rpm);
+    while (engine.angle_at(engine.now()) < 720 * 3 + stop_deg)
+        player.edge(engine.next());
+    CHECK(dec.sync_step == 3);
+    s.sync_losses += player.finish().sync_losses;
+    const absolute_time_t last_tooth = sim_now;
+    const uint32_t timeout = dec.next_timeout - last_tooth;
+    s.in_pulse += pin_high();
+
+    // the main loop stops too, only the alarm is left
+    player.main_loop = false;
+    player.idle(timeout + 1000);
+    CHECK(dec.sync_step == 0);
+    CHECK(gs.engine_speed == 0);
+    CHECK(gs.stall_latency == timeout + alarm_latency);
+    CHECK(!pin_high());
+    for (const SimEdge &e : sim_edges)
+        CHECK(e.t <= last_tooth + gs.stall_latency);
+    CHECK(sim_pending_alarms() == 0);
+
+    s.sum += gs.stall_latency;
+    s.worst = std::max(s.worst, (double)gs.stall_latency);
+    // against the gap the next tooth was due in, at the speed of the last gap
+    const uint i = dec.stop_tooth;
+    const uint32_t span = dec.wheel.tooth_span[dec.wheel.next(i)];
+    const double expected = (double)dec.delta_prev * span / dec.wheel.tooth_span[i];
+    s.worst_ratio = std::max(s.worst_ratio, (gs.stall_latency - alarm_latency) / expected);
+    s.runs += 1;
+}
+
+static void report(const char *name, const Stall &s)
+{
+    printf("%-25s: last tooth to shutdown %.0f us mean, %.0f us max, timeout %.3f x the expected gap, "
+           "%u of %u stops during a pulse, %u sync losses\n",
+           name, s.sum / s.runs, s.worst, s.worst_ratio, s.in_pulse, s.runs, s.sync_losses);
+}
+
+int main()
+{
+    static const double rpms[] = {300, 1000, 3000, 6000, 9000};
+    for (bool irq : {false, true})
+    {
+        for (const char *wheel : {"36-1", "24-1", "60-2"})
+        {
+            char name[32];
+            for (double rpm : rpms)
+            {
+                Stall s;
+                for (double stop_deg = 1; stop_deg < 720; stop_deg += 7.3)
+                    stop_at(s, wheel, [rpm](double) { return rpm; }, stop_deg, irq);
+                snprintf(name, sizeof(name), "%s%s, %.0f rpm", irq ? "irq, " : "", wheel, rpm);
+                report(name, s);
+                // the margin over the next gap, then the alarm latency
+                CHECK(s.worst_ratio < ((rpm < DECODER_CRANKING_RPM) ? 2.005 : 1.255));
+                CHECK(s.in_pulse > 0);
+                CHECK(s.sync_losses == 0);
+            }
+
+            // cranking, two compression strokes per turn slow the crank by 30%
+            Stall s;
+            for (double stop_deg = 1; stop_deg < 720; stop_deg += 7.3)
+                stop_at(s, wheel, [](double t) { return 200 * (1 + 0.3 * std::sin(2 * M_PI * t * 200 / 60e6 * 2)); },
+                        stop_deg, irq);
+            snprintf(name, sizeof(name), "%s%s, cranking", irq ? "irq, " : "", wheel);
+            report(name, s);
+            CHECK(s.worst_ratio < 2.005);
+            CHECK(s.sync_losses == 0);
+        }
+    }
+
+    return test_result();
+}
@@ -0,0 +1,295 @@
+// Cycle model of pio/tooth_capture.pio, parsed from the source: the pushed
+// counts give the exact tooth periods with TOOTH_CAPTURE_EDGE_CYCLES, X going
+// through 0 adds no edge, and the FIFO stream through the capture IRQ gives
+// the tooth times to the us.
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "hardware/clocks.h"
+#include "hardware/irq.h"
+#include "sim.h"
+#include "test.h"
+#include "tooth_capture.pio.h"
+#include "trace_player.h"
+
+// Instructions used by the program, anything else fails the parse
+struct PioInstr
+{
+    enum
+    {
+        JMP,
+        JMP_X_DEC,
+        JMP_PIN,
+        MOV_ISR_X,
+        PUSH_NOBLOCK,
+    } op;
+    std::string label;
+    uint target;
+};
+
+struct PioProgram
+{
+    std::vector<PioInstr> code;
+    std::map<std::string, uint> labels;
+    uint wrap_target = 0, wrap = 0;
+    bool ok = false;
+};
+
+static PioProgram pio_parse(const std::string &source)
+{
+    PioProgram p;
+    std::istringstream in(source);
+    std::string line;
+    bool wrap_set = false;
+    while (std::getline(in, line))
+    {
+        line = line.substr(0, line.find(';'));
+        if (line.rfind("% c-sdk", 0) == 0)
+            break;
+        std::istringstream words(line);
+        std::string w;
+        if (!(words >> w))
+            continue;
+        if (w == "public")
+            words >> w;
+        if (w == ".program")
+            continue;
+        if (w == ".wrap_target")
+        {
+            p.wrap_target = p.code.size();
+            continue;
+        }
+        if (w == ".wrap")
+        {
+            p.wrap = p.code.size() - 1;
+            wrap_set = true;
+            continue;
+        }
+        if (w.back() == ':')
+        {
+            p.labels[w.substr(0, w.size() - 1)] = p.code.size();
+            continue;
+        }
+        std::string a, b, rest;
+        words >> a >> b >> rest;
+        PioInstr i;
+        if ((w == "jmp") && (a == "x--") && !b.empty() && rest.empty())
+            i = {PioInstr::JMP_X_DEC, b, 0};
+        else if ((w == "jmp") && (a == "pin") && !b.empty() && rest.empty())
+            i = {PioInstr::JMP_PIN, b, 0};
+        else if ((w == "jmp") && !a.empty() && b.empty())
+            i = {PioInstr::JMP, a, 0};
+        else if ((w == "mov") && (a == "isr,") && (b == "x") && rest.empty())
+            i = {PioInstr::MOV_ISR_X, "", 0};
+        else if ((w == "push") && (a == "noblock") && b.empty())
+            i = {PioInstr::PUSH_NOBLOCK, "", 0};
+        else
+        {
+            printf("unsupported instruction: %s\n", line.c_str());
+            return p;
+        }
+        p.code.push_back(i);
+    }
+    for (PioInstr &i : p.code)
+    {
+        if (i.label.empty())
+            continue;
+        if (!p.labels.count(i.label))
+        {
+            printf("unknown label %s\n", i.label.c_str());
+            return p;
+        }
+        i.target = p.labels[i.label];
+    }
+    if (!wrap_set)
+        p.wrap = p.code.size() - 1;
+    p.ok = !p.code.empty();
+    return p;
+}
+
+struct PioPush
+{
+    uint64_t cycle;
+    uint32_t value;
+};
+
+// One state machine at one instruction per cycle, the JMP pin is high from
+// every rise for its high time
+struct PioModel
+{
+    const PioProgram &p;
+    uint pc;
+    uint32_t x, isr = 0;
+    uint64_t cycle = 0;
+    std::vector<PioPush> pushes;
+
+    PioModel(const PioProgram &program, uint start, uint32_t x0) : p(program), pc(start), x(x0) {}
+
+    void run(uint64_t until, bool pin)
+    {
+        while (cycle < until)
+        {
+            const PioInstr &i = p.code[pc];
+            bool jump = false;
+            switch (i.op)
+            {
+            case PioInstr::JMP:
+                jump = true;
+                break;
+            case PioInstr::JMP_X_DEC:
+                jump = x != 0;
+                x -= 1;
+                break;
+            case PioInstr::JMP_PIN:
+                jump = pin;
+                break;
+            case PioInstr::MOV_ISR_X:
+                isr = x;
+                break;
+            case PioInstr::PUSH_NOBLOCK:
+                pushes.push_back({cycle, isr});
+                isr = 0;
+                break;
+            }
+            pc = jump ? i.target : (pc == p.wrap) ? p.wrap_target : pc + 1;
+            cycle += 1;
+        }
+    }
+};
+
+static std::string read_file(const char *path)
+{
+    std::ifstream f(path);
+    std::stringstream s;
+    s << f.rdbuf();
+    return s.str();
+}
+
+// Periods in system clocks, 50% duty. Returns the rise cycles.
+static std::vector<uint64_t> play(PioModel &m, const std::vector<uint32_t> &periods, uint64_t start)
+{
+    std::vector<uint64_t> rises;
+    m.run(start, false);
+    uint64_t t = start;
+    for (const uint32_t period : periods)
+    {
+        rises.push_back(t);
+        m.run(t + period / 2, true);
+        m.run(t + period, false);
+        t += period;
+    }
+    m.run(t + 16, false);
+    return rises;
+}
+
+static std::vector<uint32_t> random_periods(uint n, uint32_t min, uint32_t max, uint seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<uint32_t> dist(min, max);
+    std::vector<uint32_t> periods(n);
+    for (uint32_t &p : periods)
+        p = dist(rng);
+    return periods;
+}
+
+// pushes match the rises, periods exact to the 2 clock sampling
+static void check_periods(const PioModel &m, const std::vector<uint64_t> &rises, const char *what)
+{
+    CHECK(m.pushes.size() == rises.size());
+    if (m.pushes.size() != rises.size())
+    {
+        printf("%s: %zu pushes for %zu edges\n", what, m.pushes.size(), rises.size());
+        return;
+    }
+    int64_t err_max = 0, err_sum = 0;
+    for (size_t i = 1; i < rises.size(); i++)
+    {
+        const uint32_t cycles = 2 * (m.pushes[i - 1].value - m.pushes[i].value) + TOOTH_CAPTURE_EDGE_CYCLES;
+        const int64_t err = (int64_t)cycles - (int64_t)(rises[i] - rises[i - 1]);
+        err_max = std::max(err_max, std::abs(err));
+        err_sum += err;
+        // sampled every 2 clocks, detected at most 2 clocks after the rise
+        CHECK((m.pushes[i].cycle - rises[i] >= 2) && (m.pushes[i].cycle - rises[i] <= 4));
+    }
+    printf("%s: %zu edges, period error max %lld clocks, total %lld\n", what, rises.size(),
+           (long long)err_max, (long long)err_sum);
+    CHECK(err_max <= 2);
+    CHECK(std::abs(err_sum) <= 2);
+}
+
+int main()
+{
+    const PioProgram p = pio_parse(read_file(PIO_DIR "/tooth_capture.pio"));
+    CHECK(p.ok);
+    if (!p.ok)
+        return test_result();
+    CHECK(p.labels.count("high") && (p.labels.at("high") == tooth_capture_offset_high));
+
+    // 53 to 667 us at 150 MHz
+    {
+        PioModel m(p, tooth_capture_offset_high, 0x12345678);
+        const std::vector<uint32_t> periods = random_periods(2000, 8000, 100000, 1);
+        check_periods(m, play(m, periods, 1000), "random periods");
+    }
+    // odd and even periods, short ones
+    {
+        PioModel m(p, tooth_capture_offset_high, 0);
+        const std::vector<uint32_t> periods = random_periods(2000, 12, 41, 2);
+        check_periods(m, play(m, periods, 7), "short periods");
+    }
+    // X goes through 0 in the low loop, the high loop and the rise path
+    for (uint32_t x0 = 0; x0 < 64; x0++)
+    {
+        PioModel m(p, tooth_capture_offset_high, x0);
+        const std::vector<uint32_t> periods(8, 20);
+        const std::vector<uint64_t> rises = play(m, periods, 10);
+        CHECK(m.pushes.size() == rises.size());
+    }
+    {
+        PioModel m(p, tooth_capture_offset_high, 3);
+        const std::vector<uint32_t> periods = random_periods(200, 20, 100, 3);
+        check_periods(m, play(m, periods, 40), "X through 0");
+    }
+    // pin low at start is not an edge
+    {
+        PioModel m(p, tooth_capture_offset_high, 0);
+        m.run(1000, false);
+        CHECK(m.pushes.empty());
+    }
+
+    // FIFO stream through the capture IRQ: timestamps to the us
+    sim_reset();
+    static Decoder dec;
+    static GlobalState gs = {};
+    dec.wheel.missing_tooth(36, 1, 1);
+    dec.enable(&gs, 0, true);
+    const uint32_t clocks_per_us = clock_get_hz(clk_sys) / 1'000'000;
+    PioModel m(p, tooth_capture_offset_high, 5);
+    const std::vector<uint32_t> periods = random_periods(2000, 20 * clocks_per_us, 1000 * clocks_per_us, 4);
+    const std::vector<uint64_t> rises = play(m, periods, 1000);
+    CHECK(m.pushes.size() == rises.size());
+    int64_t ts_err_max = 0;
+    for (size_t i = 0; i < m.pushes.size() && i < rises.size(); i++)
+    {
+        sim_run_until(m.pushes[i].cycle / clocks_per_us);
+        sim_pio_rx_push(1, 0, m.pushes[i].value);
+        sim_irq(PIO1_IRQ_0);
+        ToothEvent ev = {};
+        CHECK(dec.ring.pop(ev));
+        // the first tooth sets the time base
+        const int64_t err = (int64_t)ev.ts - (int64_t)(m.pushes[0].cycle / clocks_per_us) -
+                            (int64_t)((rises[i] - rises[0]) / clocks_per_us);
+        ts_err_max = std::max(ts_err_max, std::abs(err));
+    }
+    printf("capture IRQ: %zu teeth, timestamp error max %lld us\n", m.pushes.size(), (long long)ts_err_max);
+    CHECK(ts_err_max <= 1);
+
+    return test_result();
+}
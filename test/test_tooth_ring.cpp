@@ -0,0 +1,66 @@
+// A 5 ms main loop stall at 8000 rpm loses no tooth and keeps the sync, the
+// teeth wait in the ring. A stall longer than the ring counts overflows.
+
+
+#include "sim.h"
+#include "synthetic.h"
+#include "test.h"
+#include "trace_player.h"
+
+static Decoder dec;
+static GlobalState gs;
+
+struct StallResult
+{
+    uint teeth;          // crank teeth during the stall
+    uint32_t overflows;
+    bool synced;         // full sync after the drain
+    bool count_ok;       // sync_count moved by the teeth of the stall
+};
+
+static StallResult stall_test(double rpm, uint32_t stall_us)
+{
+    decoder_reset(dec, gs);
+    TracePlayer player(dec, gs);
+
+    SyntheticEngine engine(dec.wheel, [rpm](double) { return rpm; });
+    while (engine.now() < 200'000)
+        player.edge(engine.next());
+    const uint count0 = dec.sync_count;
+
+    // main loop stuck, the GPIO IRQ keeps pushing
+    StallResult r = {};
+    player.main_loop = false;
+    const double stall_end = engine.now() + stall_us;
+    while (engine.now() < stall_end)
+    {
+        player.edge(engine.next());
+        r.teeth += 1;
+    }
+    player.main_loop = true;
+    player.update();
+
+    r.overflows = gs.tooth_overflows;
+    r.synced = (dec.sync_step == 3) && (player.finish().sync_losses == 0);
+    r.count_ok = dec.sync_count == (count0 + r.teeth) % dec.wheel.n_teeth;
+    return r;
+}
+
+int main()
+{
+    const StallResult r = stall_test(8000, 5000);
+    printf("8000 rpm, 5 ms stall: %u teeth queued, %u lost, sync %s\n",
+           r.teeth, r.overflows, r.synced ? "kept" : "lost");
+    CHECK(r.teeth > 20);
+    CHECK(r.teeth < DECODER_RING_SIZE);
+    CHECK(r.overflows == 0);
+    CHECK(r.synced);
+    CHECK(r.count_ok);
+
+    // the ring is the limit, past it the teeth are counted as lost
+    const StallResult over = stall_test(8000, 20000);
+    printf("8000 rpm, 20 ms stall: %u teeth, %u lost\n", over.teeth, over.overflows);
+    CHECK(over.overflows == over.teeth - DECODER_RING_SIZE);
+
+    return test_result();
+}
@@ -0,0 +1,84 @@
+// Trace files load back what was saved, and a synthetic engine start replays
+// with sync, no losses and the engine speed of the generator.
+// With a path argument, writes the start trace there (traces/36-1_start.csv).
+
+#include <cmath>
+
+#include "sim.h"
+#include "synthetic.h"
+#include "test.h"
+#include "trace_player.h"
+
+// 250 rpm cranking with compression ripple, then up to 2500 rpm
+static double start_rpm(double t)
+{
+    if (t < 500'000)
+        return 250 + 30 * std::sin(2 * M_PI * t * 250 / 60e6 * 2);
+    if (t < 1'500'000)
+        return 250 + 2250 * (t - 500'000) / 1'000'000;
+    return 2500;
+}
+
+static std::vector<TraceEdge> start_trace(const WheelPattern &wheel)
+{
+    SyntheticEngine engine(wheel, start_rpm, 100);
+    std::vector<TraceEdge> trace;
+    while (engine.now() < 2'000'000)
+        trace.push_back(engine.next());
+    return trace;
+}
+
+static ReplayStats replay(const std::vector<TraceEdge> &trace)
+{
+    static Decoder dec;
+    static GlobalState gs;
+    decoder_reset(dec, gs);
+    TracePlayer player(dec, gs);
+    player.run(trace);
+    return player.finish();
+}
+
+int main(int argc, char **argv)
+{
+    WheelPattern wheel;
+    CHECK(trace_wheel("36-1", 1, wheel));
+    CHECK(wheel.n_teeth == 35);
+    WheelPattern plus;
+    CHECK(trace_wheel("12+1", 2, plus));
+    CHECK(plus.n_teeth == 13);
+    CHECK(!trace_wheel("36x1", 1, plus));
+
+    const std::vector<TraceEdge> trace = start_trace(wheel);
+    if (argc > 1)
+        return trace_save(argv[1], trace) ? 0 : 1;
+
+    // both formats load back, the binary one without the reference speed
+    std::vector<TraceEdge> csv, bin;
+    CHECK(trace_save("trace_player.csv", trace) && trace_load("trace_player.csv", csv));
+    CHECK(trace_save("trace_player.bin", trace) && trace_load("trace_player.bin", bin));
+    CHECK((csv.size() == trace.size()) && (bin.size() == trace.size()));
+    for (size_t i = 0; i < trace.size() && i < csv.size() && i < bin.size(); i++)
+    {
+        CHECK((csv[i].period == trace[i].period) && (csv[i].input == trace[i].input));
+        CHECK(std::fabs(csv[i].rpm - trace[i].rpm) < 0.1);
+        CHECK((bin[i].period == trace[i].period) && (bin[i].input == trace[i].input) && (bin[i].rpm == 0));
+    }
+
+    const ReplayStats s = replay(csv);
+    printf("csv: sync after %d teeth, %u losses, rpm error %.3f %% rms, %.3f %% max, %.0f ns per edge\n",
+           s.sync_teeth, s.sync_losses, s.rpm_rms_error, s.rpm_max_error, s.ns_per_tooth);
+    CHECK((s.sync_teeth > 0) && (s.sync_teeth <= 2 * 36));
+    CHECK(s.sync_losses == 0);
+    CHECK(s.rpm_samples > 1000);
+    CHECK(s.rpm_rms_error < 1.0);
+
+    // against the mean of the last turn when the trace has no reference, the
+    // cranking ripple the decoder follows is averaged out of it
+    const ReplayStats sb = replay(bin);
+    printf("bin: sync after %d teeth, %u losses, rpm error %.3f %% rms\n", sb.sync_teeth, sb.sync_losses, sb.rpm_rms_error);
+    CHECK(sb.sync_teeth == s.sync_teeth);
+    CHECK(sb.rpm_samples > 1000);
+    CHECK(sb.rpm_rms_error < 10.0);
+
+    return test_result();
+}
@@ -0,0 +1,226 @@
+// Trigger queue on its own: pulses in order come out as queued, adjacent
+// ones are chained without a low gap, overlapping ones and those past the
+// queue size are rejected and leave the queued ones untouched. A pending
+// pulse moved by retarget() fires once at its new time, never twice, also
+// when the move races its own alarm.
+
+#include <new>
+
+#include "sim.h"
+#include "synthetic.h"
+#include "test.h"
+#include "trace_player.h"
+#include "trigger.h"
+
+static Trigger trig;
+static const uint pin = 5;
+
+static void reset()
+{
+    sim_reset();
+    trig.~Trigger();
+    new (&trig) Trigger();
+    trig.init(pin);
+}
+
+// edges of the pin as (time, high) pairs, compared to the expected ones
+static bool edges_are(std::initializer_list<std::pair<absolute_time_t, bool>> expected)
+{
+    std::vector<std::pair<absolute_time_t, bool>> got;
+    for (const SimEdge &e : sim_edges)
+        if (e.mask & (1u << pin))
+            got.push_back({e.t, e.high});
+    const bool same = (got == std::vector<std::pair<absolute_time_t, bool>>(expected));
+    if (!same)
+    {
+        for (auto &g : got)
+            printf("  %llu %s\n", (unsigned long long)g.first, g.second ? "high" : "low");
+    }
+    return same;
+}
+
+int main()
+{
+    // separate pulses
+    reset();
+    CHECK(trig.update(1000, 200));
+    CHECK(trig.update(1500, 200));
+    CHECK(trig.update(2000, 100));
+    sim_run_until(5000);
+    CHECK(edges_are({{1000, true}, {1200, false}, {1500, true}, {1700, false}, {2000, true}, {2100, false}}));
+    CHECK(trig.stats.rejected == 0);
+    CHECK(sim_pending_alarms() == 0);
+
+    // adjacent pulses, one high from the start of the first to the end of the last
+    reset();
+    CHECK(trig.update(1000, 500));
+    CHECK(trig.update(1500, 500));
+    CHECK(trig.update(2000, 300));
+    sim_run_until(5000);
+    CHECK(edges_are({{1000, true}, {2300, false}}));
+    CHECK(trig.stats.rejected == 0);
+
+    // adjacent pulse queued while the first is already high
+    reset();
+    CHECK(trig.update(1000, 500));
+    sim_run_until(1200);
+    CHECK(trig.update(1500, 500));
+    sim_run_until(5000);
+    CHECK(edges_are({{1000, true}, {2000, false}}));
+
+    // one microsecond apart is not adjacent
+    reset();
+    CHECK(trig.update(1000, 500));
+    CHECK(trig.update(1501, 500));
+    sim_run_until(5000);
+    CHECK(edges_are({{1000, true}, {1500, false}, {1501, true}, {2001, false}}));
+
+    // overlapping the last queued pulse, rejected
+    reset();
+    CHECK(trig.update(1000, 500));
+    CHECK(!trig.update(1499, 500));
+    CHECK(!trig.update(900, 50)); // out of order
+    CHECK(trig.update(1600, 100));
+    sim_run_until(5000);
+    CHECK(edges_are({{1000, true}, {1500, false}, {1600, true}, {1700, false}}));
+    CHECK(trig.stats.rejected == 2);
+
+    // overlapping while the first is high, rejected, the first keeps its end
+    reset();
+    CHECK(trig.update(1000, 500));
+    sim_run_until(1200);
+    CHECK(!trig.update(1300, 500));
+    sim_run_until(5000);
+    CHECK(edges_are({{1000, true}, {1500, false}}));
+    CHECK(trig.stats.rejected == 1);
+
+    // queue full
+    reset();
+    for (uint i = 0; i < TRIGGER_QUEUE_SIZE; i++)
+        CHECK(trig.update(1000 + i * 1000, 100));
+    CHECK(!trig.update(1000 + TRIGGER_QUEUE_SIZE * 1000, 100));
+    sim_run_until(1050); // the first one left the queue
+    CHECK(trig.update(1000 + TRIGGER_QUEUE_SIZE * 1000, 100));
+    sim_run_until(10000);
+    CHECK(edges_are({{1000, true}, {1100, false}, {2000, true}, {2100, false}, {3000, true}, {3100, false},
+                     {4000, true}, {4100, false}, {5000, true}, {5100, false}}));
+    CHECK(trig.stats.rejected == 1);
+
+    // cancelled mid-pulse: low at once, the queued ones dropped
+    reset();
+    CHECK(trig.update(1000, 500));
+    CHECK(trig.update(1500, 500));
+    CHECK(trig.update(3000, 500));
+    sim_run_until(1700);
+    trig.cancel();
+    sim_run_until(5000);
+    CHECK(edges_are({{1000, true}, {1700, false}}));
+    CHECK(sim_pending_alarms() == 0);
+    CHECK(trig.update(1000 + sim_now, 100)); // queued again from scratch
+    sim_run_until(10000);
+    CHECK(edges_are({{1000, true}, {1700, false}, {6000, true}, {6100, false}}));
+
+    // retarget earlier, then later
+    reset();
+    CHECK(trig.update(5000, 200));
+    sim_run_until(1000);
+    CHECK(trig.retarget(4000, 200) == 1);
+    sim_run_until(10000);
+    CHECK(edges_are({{4000, true}, {4200, false}}));
+    CHECK(sim_pending_alarms() == 0);
+    reset();
+    CHECK(trig.update(5000, 200));
+    sim_run_until(1000);
+    CHECK(trig.retarget(6000, 300) == 1);
+    CHECK(trig.retarget(6500, 300) == 1);
+    sim_run_until(10000);
+    CHECK(edges_are({{6500, true}, {6800, false}}));
+    CHECK(sim_pending_alarms() == 0);
+
+    // unchanged target, the alarm is left armed
+    reset();
+    CHECK(trig.update(5000, 200));
+    CHECK(trig.retarget(5000, 200) == 0);
+    CHECK(sim_pending_alarms() == 1);
+    sim_run_until(10000);
+    CHECK(edges_are({{5000, true}, {5200, false}}));
+
+    // already started, or another pulse queued ahead: too late to move
+    reset();
+    CHECK(trig.update(5000, 200));
+    sim_run_until(5100);
+    CHECK(trig.retarget(5300, 200) == -1);
+    sim_run_until(10000);
+    CHECK(edges_are({{5000, true}, {5200, false}}));
+    reset();
+    CHECK(trig.update(5000, 200));
+    CHECK(trig.update(6000, 200));
+    CHECK(trig.retarget(7000, 200) == -1);
+    sim_run_until(10000);
+    CHECK(edges_are({{5000, true}, {5200, false}, {6000, true}, {6200, false}}));
+
+    // the alarm is due but its callback did not run yet: still moved
+    reset();
+    sim_alarm_latency = 5;
+    CHECK(trig.update(5000, 200));
+    sim_run_until(5003);
+    CHECK(trig.retarget(5100, 200) == 1);
+    sim_run_until(10000);
+    CHECK(edges_are({{5105, true}, {5305, false}}));
+    CHECK(sim_pending_alarms() == 0);
+
+    // a tooth preempting fire() right after the edge cannot move the pulse:
+    // one start edge, one end edge
+    reset();
+    CHECK(trig.update(5000, 200));
+    int raced = 0;
+    sim_edge_irq = [&]() { raced = trig.retarget(5400, 200); };
+    sim_run_until(10000);
+    CHECK(raced == -1);
+    CHECK(edges_are({{5000, true}, {5200, false}}));
+    CHECK(sim_pending_alarms() == 0);
+
+    // same at the end edge of a pulse, with the next one queued: the chain
+    // keeps its alarm for the next pulse
+    reset();
+    CHECK(trig.update(5000, 200));
+    CHECK(trig.update(6000, 200));
+    raced = 0;
+    sim_edge_irq = [&]() { sim_edge_irq = [&]() { raced = trig.retarget(6500, 200); }; };
+    sim_run_until(10000);
+    CHECK(raced == -1);
+    CHECK(edges_are({{5000, true}, {5200, false}, {6000, true}, {6200, false}}));
+    CHECK(sim_pending_alarms() == 0);
+
+    // from the decoder: an accelerating engine moves its pending pulses,
+    // none of them is late or fires twice
+    static Decoder dec;
+    static GlobalState gs;
+    decoder_reset(dec, gs);
+    trigger_reset(trig, pin);
+    dec.set_output(0, &trig);
+    dec.request_output(0, 0x2000, 8000);
+    TracePlayer player(dec, gs);
+    SyntheticEngine engine(dec.wheel, [](double t) { return 1000 + 5000 * std::min(t / 2e6, 1.0); });
+    while (engine.now() < 3e6)
+        player.edge(engine.next());
+    uint highs = 0, lows = 0;
+    bool high = false, double_edge = false;
+    for (const SimEdge &e : sim_edges)
+    {
+        if (!(e.mask & (1u << pin)))
+            continue;
+        double_edge |= (e.high == high);
+        high = e.high;
+        (e.high ? highs : lows) += 1;
+    }
+    printf("decoder: %u pulses, %lu retargets, %lu late\n", highs, (unsigned long)gs.output_retargets,
+           (unsigned long)gs.output_late);
+    CHECK(highs > 20);
+    CHECK(highs - lows <= 1);
+    CHECK(!double_edge);
+    CHECK(gs.output_retargets > 0);
+    CHECK(gs.output_late == 0);
+
+    return test_result();
+}
@@ -0,0 +1,209 @@
+#include "trace_player.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <new>
+
+#include "sim.h"
+
+static bool is_bin(const char *path)
+{
+    const size_t n = strlen(path);
+    return (n > 4) && (strcmp(path + n - 4, ".bin") == 0);
+}
+
+bool trace_load(const char *path, std::vector<TraceEdge> &trace)
+{
+    FILE *f = fopen(path, is_bin(path) ? "rb" : "r");
+    if (!f)
+        return false;
+    trace.clear();
+    if (is_bin(path))
+    {
+        uint8_t b[4];
+        while (fread(b, 1, 4, f) == 4)
+        {
+            const uint32_t w = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+            trace.push_back({w & 0x7FFFFFFF, (uint8_t)(w >> 31), 0});
+        }
+    }
+    else
+    {
+        char line[256];
+        while (fgets(line, sizeof(line), f))
+        {
+            unsigned long period;
+            unsigned input = 0;
+            float rpm = 0;
+            if ((line[0] == '#') || (sscanf(line, "%lu,%u,%f", &period, &input, &rpm) < 1))
+                continue;
+            trace.push_back({(uint32_t)period, (uint8_t)(input != 0), rpm});
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+bool trace_save(const char *path, const std::vector<TraceEdge> &trace)
+{
+    FILE *f = fopen(path, is_bin(path) ? "wb" : "w");
+    if (!f)
+        return false;
+    for (const TraceEdge &e : trace)
+    {
+        if (is_bin(path))
+        {
+            const uint32_t w = (e.period & 0x7FFFFFFF) | ((uint32_t)e.input << 31);
+            const uint8_t b[4] = {(uint8_t)w, (uint8_t)(w >> 8), (uint8_t)(w >> 16), (uint8_t)(w >> 24)};
+            fwrite(b, 1, 4, f);
+        }
+        else if (e.rpm > 0)
+        {
+            fprintf(f, "%u,%u,%.1f\n", e.period, e.input, e.rpm);
+        }
+        else
+        {
+            fprintf(f, "%u,%u\n", e.period, e.input);
+        }
+    }
+    return fclose(f) == 0;
+}
+
+bool trace_wheel(const char *name, uint revs, WheelPattern &wheel)
+{
+    uint n, m;
+    char sign;
+    if (sscanf(name, "%u%c%u", &n, &sign, &m) != 3)
+        return false;
+    if (sign == '-')
+        return wheel.missing_tooth(n, m, revs);
+    if ((sign == '+') && (m == 1))
+        return wheel.plus_one(n, revs);
+    return false;
+}
+
+bool decoder_reset(Decoder &dec, GlobalState &gs, const char *wheel, uint revs)
+{
+    sim_reset();
+    dec.~Decoder();
+    new (&dec) Decoder();
+    gs = {};
+    if (!trace_wheel(wheel, revs, dec.wheel))
+        return false;
+    dec.enable(&gs, TracePlayer(dec, gs).crank_pin);
+    return true;
+}
+
+void trigger_reset(Trigger &trig, uint pin)
+{
+    trig.~Trigger();
+    new (&trig) Trigger();
+    trig.init(pin);
+}
+
+void TracePlayer::idle(uint32_t us)
+{
+    const absolute_time_t t = sim_now + us;
+    if (main_loop)
+    {
+        // the main loop keeps polling while no tooth comes
+        for (absolute_time_t tl = sim_now + 1000; tl < t; tl += 1000)
+        {
+            sim_run_until(tl);
+            update();
+        }
+    }
+    sim_run_until(t);
+    check_sync();
+}
+
+void TracePlayer::update()
+{
+    const auto h0 = std::chrono::steady_clock::now();
+    dec.update(&gs);
+    host_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - h0).count();
+    check_sync();
+}
+
+void TracePlayer::check_sync()
+{
+    const bool full = dec.sync_step == 3;
+    if (full && !synced && (stats.sync_teeth < 0))
+    {
+        stats.sync_teeth = stats.teeth;
+        stats.sync_us = sim_now - t0;
+    }
+    else if (!full && synced)
+    {
+        stats.sync_losses += 1;
+    }
+    synced = full;
+}
+
+void TracePlayer::sample_rpm(float rpm)
+{
+    if ((dec.sync_step != 3) || (gs.engine_speed == 0))
+        return;
+    if (rpm <= 0)
+    {
+        // no reference: mean speed over the last wheel turn
+        if (wheel_periods.size() < dec.wheel.n_teeth)
+            return;
+        rpm = (double)dec.wheel.revs * 60e6 / wheel_sum;
+    }
+    const double err = 100.0 * std::fabs(gs.engine_speed - rpm) / rpm;
+    rpm_sq_sum += err * err;
+    stats.rpm_max_error = std::fmax(stats.rpm_max_error, err);
+    stats.rpm_samples += 1;
+}
+
+void TracePlayer::edge(const TraceEdge &e)
+{
+    if (edges == 0)
+        t0 = sim_now + e.period;
+    edges += 1;
+    sim_run_until(sim_now + e.period);
+    check_sync(); // the stall alarm may have fired
+
+    const auto h0 = std::chrono::steady_clock::now();
+    sim_gpio_irq(e.input ? cam_pin : crank_pin);
+    host_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - h0).count();
+
+    if (e.input)
+    {
+        stats.cam_edges += 1;
+    }
+    else
+    {
+        stats.teeth += 1;
+        // crank period since the previous crank edge, cam edges in between included
+        if (crank_prev)
+        {
+            const uint32_t period = sim_now - crank_prev;
+            if (wheel_periods.size() < dec.wheel.n_teeth)
+            {
+                wheel_periods.push_back(period);
+            }
+            else
+            {
+                wheel_sum -= wheel_periods[wheel_pos];
+                wheel_periods[wheel_pos] = period;
+                wheel_pos = (wheel_pos + 1) % wheel_periods.size();
+            }
+            wheel_sum += period;
+        }
+        crank_prev = sim_now;
+    }
+    if (main_loop)
+        update();
+    if (!e.input)
+        sample_rpm(e.rpm);
+}
+
+const ReplayStats &TracePlayer::finish()
+{
+    stats.rpm_rms_error = stats.rpm_samples ? std::sqrt(rpm_sq_sum / stats.rpm_samples) : 0;
+    stats.ns_per_tooth = edges ? (double)host_ns / edges : 0;
+    return stats;
+}
@@ -0,0 +1,85 @@
+#ifndef __TRACE_PLAYER_H__
+#define __TRACE_PLAYER_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "decoder.h"
+
+// One recorded edge
+struct TraceEdge
+{
+    uint32_t period; // 1 us since the previous edge of any input
+    uint8_t input;   // 0=crank, 1=cam
+    float rpm;       // reference engine speed, 0=unknown
+};
+
+// CSV: one edge per line, "period_us[,input[,rpm]]", '#' starts a comment.
+// Binary (.bin): little-endian uint32 per edge, period_us | cam << 31.
+bool trace_load(const char *path, std::vector<TraceEdge> &trace);
+bool trace_save(const char *path, const std::vector<TraceEdge> &trace);
+
+struct ReplayStats
+{
+    uint teeth = 0;       // crank edges played
+    uint cam_edges = 0;
+    int sync_teeth = -1;  // crank edges before the first full sync, -1=never
+    uint32_t sync_us = 0; // time from the first edge to the first full sync
+    uint sync_losses = 0; // full sync lost after it was found
+    uint rpm_samples = 0;
+    double rpm_rms_error = 0; // %, engine_speed against the reference
+    double rpm_max_error = 0; // %
+    double ns_per_tooth = 0;  // host time in the IRQ glue and update() per edge
+};
+
+// Plays edges through the GPIO IRQ of the real decoder glue, time is
+// simulated: the alarms due before every edge fire first. The decoder must
+// be enabled by the caller, on crank_pin and cam_pin.
+class TracePlayer
+{
+    Decoder &dec;
+    GlobalState &gs;
+    std::vector<uint32_t> wheel_periods; // crank periods of the last wheel turn
+    uint wheel_pos = 0;
+    uint64_t wheel_sum = 0;
+    absolute_time_t crank_prev = 0;
+    uint64_t host_ns = 0;
+    uint32_t edges = 0;
+    bool synced = false;
+    double rpm_sq_sum = 0;
+
+    void sample_rpm(float rpm);
+    void check_sync();
+
+public:
+    uint crank_pin = 0, cam_pin = 1;
+    bool main_loop = true; // update() after every edge
+    absolute_time_t t0 = 0; // time of the first edge
+    ReplayStats stats;
+
+    TracePlayer(Decoder &d, GlobalState &g) : dec(d), gs(g) {}
+
+    // Move the time on without an edge, the alarms due fire
+    void idle(uint32_t us);
+    void edge(const TraceEdge &e);
+    void run(const std::vector<TraceEdge> &trace)
+    {
+        for (const TraceEdge &e : trace)
+            edge(e);
+    }
+    // Main loop pass, without an edge
+    void update();
+    const ReplayStats &finish();
+};
+
+// Test fixture: a fresh simulation, dec and gs re-created in place, the
+// wheel from its name, enabled on the crank pin of a TracePlayer. false if
+// the wheel name is not known.
+bool decoder_reset(Decoder &dec, GlobalState &gs, const char *wheel = "36-1", uint revs = 1);
+// Test fixture: trig re-created in place, driving pin
+void trigger_reset(Trigger &trig, uint pin);
+
+// Wheel from its name: "36-1", "60-2", "12+1", crank or cam wheel
+bool trace_wheel(const char *name, uint revs, WheelPattern &wheel);
+
+#endif // __TRACE_PLAYER_H__
@@ -0,0 +1,90 @@
+// Replays a recorded tooth trace through the decoder and reports the sync
+// and speed quality, exits non-zero when a limit is passed.
+//
+// trace_replay <trace.csv|trace.bin> <wheel> [options]
+//   wheel: 36-1, 60-2, 12+1, ...
+//   --cam-wheel         the wheel turns once per cycle
+//   --cam-angle <deg>   engine angle of the cam edge, crank wheel only
+//   --max-sync <teeth>  crank edges allowed before full sync
+//   --max-losses <n>    full sync losses allowed
+//   --max-rpm-error <%> RMS engine speed error allowed
+
+#include <cstdlib>
+#include <cstring>
+
+#include "sim.h"
+#include "trace_player.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        printf("usage: %s <trace> <wheel> [--cam-wheel] [--cam-angle deg] "
+               "[--max-sync teeth] [--max-losses n] [--max-rpm-error %%]\n",
+               argv[0]);
+        return 2;
+    }
+    uint revs = 1;
+    int cam_angle = -1;
+    int max_sync = -1, max_losses = -1;
+    double max_rpm_error = -1;
+    for (int i = 3; i < argc; i++)
+    {
+        const bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--cam-wheel") == 0)
+            revs = 2;
+        else if ((strcmp(argv[i], "--cam-angle") == 0) && has_value)
+            cam_angle = atoi(argv[++i]);
+        else if ((strcmp(argv[i], "--max-sync") == 0) && has_value)
+            max_sync = atoi(argv[++i]);
+        else if ((strcmp(argv[i], "--max-losses") == 0) && has_value)
+            max_losses = atoi(argv[++i]);
+        else if ((strcmp(argv[i], "--max-rpm-error") == 0) && has_value)
+            max_rpm_error = atof(argv[++i]);
+        else
+        {
+            printf("unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    std::vector<TraceEdge> trace;
+    if (!trace_load(argv[1], trace) || trace.empty())
+    {
+        printf("cannot read %s\n", argv[1]);
+        return 2;
+    }
+
+    sim_reset();
+    static Decoder dec;
+    static GlobalState gs = {};
+    if (!trace_wheel(argv[2], revs, dec.wheel))
+    {
+        printf("bad wheel %s\n", argv[2]);
+        return 2;
+    }
+    TracePlayer player(dec, gs);
+    dec.enable(&gs, player.crank_pin);
+    if (cam_angle >= 0)
+        dec.enable_cam(player.cam_pin, (uint)cam_angle * 0x10000 / 720);
+    player.run(trace);
+    const ReplayStats &s = player.finish();
+
+    printf("%s: %u teeth, %u cam edges\n", argv[1], s.teeth, s.cam_edges);
+    if (s.sync_teeth >= 0)
+        printf("sync after %d teeth, %.1f ms\n", s.sync_teeth, s.sync_us / 1000.0);
+    else
+        printf("no sync\n");
+    printf("sync losses %u\n", s.sync_losses);
+    printf("rpm error %.3f %% rms, %.3f %% max over %u teeth\n", s.rpm_rms_error, s.rpm_max_error, s.rpm_samples);
+    printf("%.0f ns per edge\n", s.ns_per_tooth);
+
+    bool fail = false;
+    if ((max_sync >= 0) && ((s.sync_teeth < 0) || (s.sync_teeth > max_sync)))
+        fail = printf("FAIL: sync after more than %d teeth\n", max_sync) > 0;
+    if ((max_losses >= 0) && (s.sync_losses > (uint)max_losses))
+        fail = printf("FAIL: more than %d sync losses\n", max_losses) > 0;
+    if ((max_rpm_error >= 0) && (s.rpm_rms_error > max_rpm_error))
+        fail = printf("FAIL: rpm error above %.3f %%\n", max_rpm_error) > 0;
+    return fail ? 1 : 0;
+}